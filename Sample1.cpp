@@ -4,248 +4,988 @@
  *
  * @author: Teddy van Jerry
  * @licence: The MIT Licence
- * @compiler: At least C++/11
+ * @compiler: At least C++/17
+ *
+ * @version 2026/10/19
+ * - Add counting_sort_direct, and LSD_sort_pro_heap1 with no scratch memory (in place)
+ *   and with scratch for one copy (the heap2 passes)
+ * - The regression matrix covers int16 (counted directly at 100000 elements) and char16,
+ *   the parallel sorts, counting_sort_direct and the scratch budgets of the radix sorts
+ *
+ * @version 2026/10/19
+ * - Add list_sort (std::list and std::forward_list), argsort with apply_permutation,
+ *   sort_batch (one array), sort_lazy (read to the end), argsort_columns and sort_columns (one column)
+ *
+ * @version 2026/10/19
+ * - Add sort_network (up to 16 elements)
+ * - Under C++20, check at compile time that the constexpr sorts sort a std::array
+ *
+ * @version 2026/10/19
+ * - Add sort_unique (verified against std::unique) and sort_count (expanded again)
+ *
+ * @version 2026/10/19
+ * - Add sort_copy and radix_sort_copy (into a new vector, which replaces the input)
+ *
+ * @version 2026/10/19
+ * - Add segmented_sort (one segment, on all the threads and on one,
+ *   where a large segment is sorted by the medium path)
+ *
+ * @version 2026/10/19
+ * - Add insert_sorted_batch (sorting by 8 batches)
+ *
+ * @version 2026/10/19
+ * - Add sort_async and Sort_Stream (on the thread pool of the parallel sorts)
+ *
+ * @version 2026/10/19
+ * - Add the element type char16 (char16_t, sorted by comparison, not by radix)
+ *
+ * @version 2026/10/19
+ * - The regression matrix sorts 4 and 12 elements as well (the small paths of the radix sorts)
+ *
+ * @version 2026/10/19
+ * - LSD_sort_pro_heap2 runs at every size, and with no scratch memory (in place)
+ *
+ * @version 2026/10/19
+ * - Add merge_sort, parallel_merge_sort and parallel_sample_sort
+ *
+ * @version 2026/10/19
+ * - Add the regression check (--check, --write-baseline)
+ * - Verify every result against std::sort
+ *
+ * @version 2026/10/19
+ * - Add --perf (hardware counters)
+ *
+ * @version 2026/10/19
+ * - Print the phases of the radix sorts with TVJ_SORT_PROFILE
+ *
+ * @version 2026/10/19
+ * - Rewrite as a non-interactive benchmark
+ *   (distributions, element types, repetitions, CSV/JSON output)
  *
  * @version 2021/06/10
  * - Add heap_sort
- * 
+ *
  * @version 2021/03/09
  * - Modify to fit the new TVJ_Sort.h
  *
  * @version 2020/11/29
  * - Initial version
- * 
- * @note: This sample tests the speed of sorting using 'int'.
+ *
+ * @note: This sample benchmarks every sort entry point of TVJ_Sort
+ *        against std::sort and std::stable_sort.
+ *
+ * Usage: Sample1 [options]
+ *   --types   int8,int16,int32,int64,char16,float,double,string,kv
+ *   --dists   uniform,sorted,reverse,organ,few,zipf,nearly
+ *   --sizes   10,1000,100000        (any size up to 1e9)
+ *   --algos   LSD_sort_pro_heap1,... (default: all)
+ *   --reps    5                     (timed repetitions)
+ *   --warmup  1                     (untimed repetitions)
+ *   --seed    2021
+ *   --format  csv | json
+ *   --out     file                  (default: standard output)
+ *   --perf                          (add the hardware counters of one more run,
+ *                                    which need Linux perf_event access)
+ *
+ * Regression check (on a fixed matrix of algorithms, distributions and sizes):
+ *   --check          file           compare the medians with the baseline file,
+ *                                   exit 1 if a case is slower than its tolerance
+ *                                   or its output differs from std::sort
+ *   --write-baseline file           measure the matrix and write the baseline file
+ *   e.g. Sample1 --check Sample1_baseline.csv
+ *
+ * Compile with -DTVJ_SORT_PROFILE to also print the phase tree of the radix sorts.
  *
  */
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <vector>
+#include <string>
 #include <random>
 #include <algorithm>
+#include <functional>
+#include <map>
+#include <list>
+#include <forward_list>
+#include <array>
+#include <set>
 #include <iomanip>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
 #include "TVJ_Sort.h"
 #include "TVJ_Timer.h"
 using namespace std;
 
-#define _print_vec \
-for (const auto c_ : temp_vec) { \
-	std::cout << c_ << ' '; \
-} \
-std::cout << std::endl;
+// the element of the key/value benchmark, ordered by key only
+struct Key_Value
+{
+	int64_t key;
+	int64_t value;
+};
+
+inline bool operator<(const Key_Value& a, const Key_Value& b)  { return a.key < b.key; }
+inline bool operator>(const Key_Value& a, const Key_Value& b)  { return a.key > b.key; }
+inline bool operator<=(const Key_Value& a, const Key_Value& b) { return a.key <= b.key; }
+inline bool operator>=(const Key_Value& a, const Key_Value& b) { return a.key >= b.key; }
+inline bool operator==(const Key_Value& a, const Key_Value& b) { return a.key == b.key && a.value == b.value; }
+inline bool operator!=(const Key_Value& a, const Key_Value& b) { return !(a == b); }
+
+// options from the command line
+struct Options
+{
+	vector<string> types{ "int8", "int16", "int32", "int64", "char16", "float", "double", "string", "kv" };
+	vector<string> dists{ "uniform", "sorted", "reverse", "organ", "few", "zipf", "nearly" };
+	vector<size_t> sizes{ 10, 1000, 100000 };
+	vector<string> algos;        // empty means all
+	size_t reps = 5;
+	size_t warmup = 1;
+	uint64_t seed = 2021;
+	string format = "csv";
+	string out;
+	bool perf = false;
+	string check;          // the baseline file to compare with
+	string write_baseline; // the baseline file to write
+	set<string> only;      // measure only these cases (see caseKey), empty means all
+};
 
-void random(size_t n, int min_one, int max_one, vector<int>& ran)
+// one row of the result
+struct Result
 {
-	uniform_int_distribution<int> u(min_one, max_one);
-	default_random_engine e;
-	for (size_t i = 0; i != n; i++)
+	string type;
+	string dist;
+	size_t size;
+	string algo;
+	size_t reps;
+	double median_ms;
+	double p95_ms;
+	double elements_per_sec;
+	bool verified;
+	long long perf[TVJ_Perf_Counter::event_count]; // per sort, -1 if unavailable
+};
+
+// split "a,b,c" into its parts
+vector<string> split(const string& text)
+{
+	vector<string> parts;
+	stringstream ss(text);
+	string part;
+	while (getline(ss, part, ','))
 	{
-		ran.push_back(u(e));
+		if (!part.empty()) parts.push_back(part);
 	}
+	return parts;
 }
 
-// tset whether the sort is correct
-inline void checkSorted(vector<int> to_test, int ck)
+// read the options, return false on a bad option
+bool parseOptions(int argc, char** argv, Options& opt)
 {
-	int ck_now = 0;
-	for (auto iter = to_test.cbegin(); iter != to_test.cend() - 1; iter++)
+	for (int i = 1; i < argc; i++)
 	{
-		if (*iter > * (iter + 1))
+		string key = argv[i];
+		if (key == "--help" || key == "-h") return false;
+		if (key == "--perf")
 		{
-			cerr << "(failed) ";
-			return;
+			opt.perf = true;
+			continue;
+		}
+		if (i + 1 == argc)
+		{
+			cerr << "Missing value of " << key << endl;
+			return false;
+		}
+		string value = argv[++i];
+		if (key == "--types") opt.types = split(value);
+		else if (key == "--dists") opt.dists = split(value);
+		else if (key == "--algos") opt.algos = split(value);
+		else if (key == "--sizes")
+		{
+			opt.sizes.clear();
+			for (const auto& c : split(value))
+				opt.sizes.push_back(static_cast<size_t>(stod(c))); // also accepts 1e9
+		}
+		else if (key == "--reps") opt.reps = max<size_t>(1, stoull(value));
+		else if (key == "--warmup") opt.warmup = stoull(value);
+		else if (key == "--seed") opt.seed = stoull(value);
+		else if (key == "--format") opt.format = value;
+		else if (key == "--out") opt.out = value;
+		else if (key == "--check") opt.check = value;
+		else if (key == "--write-baseline") opt.write_baseline = value;
+		else
+		{
+			cerr << "Unknown option " << key << endl;
+			return false;
 		}
 	}
-	for (const auto& c : to_test)
-		ck_now ^= c;
-	if (ck_now != ck)
+	return opt.format == "csv" || opt.format == "json";
+}
+
+// a 64-bit mixer (splitmix64 finalizer)
+inline uint64_t mix(uint64_t x)
+{
+	x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+// Map a 64-bit rank onto the element type, keeping the order.
+template<typename V>
+inline V fromRank(uint64_t r)
+{
+	// integers take the highest bits, shifted into the signed range
+	constexpr int bits = 8 * sizeof(V);
+	using U = typename make_unsigned<V>::type;
+	U u = static_cast<U>(r >> (64 - bits));
+	if (is_signed<V>::value) u ^= static_cast<U>(U(1) << (bits - 1));
+	return static_cast<V>(u);
+}
+
+template<>
+inline float fromRank<float>(uint64_t r)
+{
+	return static_cast<float>(static_cast<double>(r) / 18446744073709551616.0 * 2E9 - 1E9);
+}
+
+template<>
+inline double fromRank<double>(uint64_t r)
+{
+	return static_cast<double>(r) / 18446744073709551616.0 * 2E9 - 1E9;
+}
+
+template<>
+inline string fromRank<string>(uint64_t r)
+{
+	// fixed width, so that the string order is the rank order
+	char text[17];
+	snprintf(text, sizeof text, "%016llx", static_cast<unsigned long long>(r));
+	return text;
+}
+
+template<>
+inline Key_Value fromRank<Key_Value>(uint64_t r)
+{
+	return { fromRank<int64_t>(r), static_cast<int64_t>(mix(r)) };
+}
+
+// order-independent checksum of an element
+inline uint64_t hashOf(int64_t c)          { return mix(static_cast<uint64_t>(c)); }
+inline uint64_t hashOf(double c)           { uint64_t u; memcpy(&u, &c, sizeof u); return mix(u); }
+inline uint64_t hashOf(const string& c)    { return hash<string>()(c); }
+inline uint64_t hashOf(const Key_Value& c) { return mix(hashOf(c.key) ^ c.value); }
+
+/**
+ * generate
+ * Generate n elements of the distribution dist.
+ * return vector<V>
+ */
+template<typename V>
+vector<V> generate(const string& dist, size_t n, uint64_t seed)
+{
+	mt19937_64 e(seed);
+	vector<V> data;
+	data.reserve(n);
+	const uint64_t step = n ? ~0ULL / n : 0;
+	if (dist == "uniform")
+	{
+		for (size_t i = 0; i != n; i++) data.push_back(fromRank<V>(e()));
+	}
+	else if (dist == "sorted" || dist == "nearly")
+	{
+		for (size_t i = 0; i != n; i++) data.push_back(fromRank<V>(i * step));
+		if (dist == "nearly")
+		{
+			// swap one percent of the elements with a near neighbour
+			for (size_t k = 0; n > 1 && k != n / 100 + 1; k++)
+			{
+				size_t i = e() % n, j = min(n - 1, i + e() % 16);
+				my_swap(data[i], data[j]);
+			}
+		}
+	}
+	else if (dist == "reverse")
+	{
+		for (size_t i = 0; i != n; i++) data.push_back(fromRank<V>((n - 1 - i) * step));
+	}
+	else if (dist == "organ")
 	{
-		cerr << "(failed) ";
-		return;
+		// ascending in the first half, descending in the second half
+		for (size_t i = 0; i != n; i++) data.push_back(fromRank<V>(min(i, n - 1 - i) * 2 * step));
 	}
-	cout << "(succeeded) ";
+	else if (dist == "few")
+	{
+		uint64_t values[16];
+		for (auto& c : values) c = e();
+		for (size_t i = 0; i != n; i++) data.push_back(fromRank<V>(values[e() % 16]));
+	}
+	else if (dist == "zipf")
+	{
+		// Zipf (s = 1) over at most one million distinct values
+		const size_t distinct = max<size_t>(1, min<size_t>(n, 1000000));
+		vector<double> cdf(distinct);
+		double sum = 0;
+		for (size_t k = 0; k != distinct; k++) cdf[k] = (sum += 1.0 / (k + 1));
+		uniform_real_distribution<double> u(0, sum);
+		for (size_t i = 0; i != n; i++)
+		{
+			size_t k = lower_bound(cdf.begin(), cdf.end(), u(e)) - cdf.begin();
+			data.push_back(fromRank<V>(mix(min(k, distinct - 1))));
+		}
+	}
+	return data;
 }
 
-int main(int argc, char** argv)
+// one algorithm to be benchmarked
+template<typename V>
+struct Algorithm
 {
-	TVJ_Timer timer("s.9");
-	size_t length;
-	vector<int> ran;
-	int ck = 0;
-	long long MIN_one = -1000000, MAX_one = 1000000;
-	cout << "This is the sorting programme.\nDesigned by Teddy van Jerry.\n" << endl;
-	cout << "Please input the range of random numbers: ";
-	cin >> MIN_one >> MAX_one;
-	cout << "Please input the length you want to sort: ";
-	cin >> length;
-	random(length, MIN_one, MAX_one, ran);
-	for (const auto& c : ran)
-		ck ^= c; // calculate the initial result
-
-	// standard algorithm sort defined in C++ library
-	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "STL_sort: ";
-		timer.restart();
-		sort(temp_vec.begin(), temp_vec.end());
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+	string name;
+	size_t max_n;            // larger inputs are skipped
+	size_t max_n_structured; // the limit for inputs that are not uniform
+	function<void(vector<V>&)> run;
+	bool distinct = false;   // run leaves the distinct elements (as std::unique after std::sort)
+};
+
+const size_t no_limit = ~static_cast<size_t>(0);
+
+// The executor of sort_async and Sort_Stream in the benchmark:
+// the pool of the parallel sorts, as a new thread per task would take longer than a small sort.
+inline void onPool(function<void()> task)
+{
+	Sort_Pool::shared()(move(task));
+}
+
+/**
+ * network sort
+ * Sort v by the sorting network of its size, if it has no more than N elements.
+ * return void
+ */
+template<size_t N, typename V>
+void networkSort(vector<V>& v)
+{
+	if (v.size() == N) sort_network<N>(v.begin());
+	else if constexpr (N > 0) networkSort<N - 1>(v);
+}
+
+/**
+ * counting sort
+ * Sort v by counting_sort_direct if its range is small enough,
+ * and by LSD_sort_pro_heap1 if not.
+ * return void
+ */
+template<typename V>
+void countingSort(vector<V>& v)
+{
+	if (v.empty()) return;
+	auto range = minmax_element(v.begin(), v.end());
+	if (!counting_sort_direct(v, *range.first, *range.second, sort_budget_unlimited)) LSD_sort_pro_heap1(v);
+}
+
+/**
+ * count sort
+ * Sort by sort_count: write every distinct element as many times as it occurs.
+ * return void
+ */
+template<typename V>
+void countSort(vector<V>& v)
+{
+	vector<size_t> counts;
+	auto keys = sort_count(v, counts);
+	v.clear();
+	for (size_t k = 0; k != keys.size(); k++)
+		v.insert(v.end(), counts[k], keys[k]);
+}
+
+/**
+ * batch sort
+ * Build the sorted vector from empty by 8 batches of insert_sorted_batch.
+ * return void
+ */
+template<typename V>
+void batchSort(vector<V>& v)
+{
+	vector<V> sorted;
+	sorted.reserve(v.size());
+	const size_t chunk = v.size() / 8 + 1;
+	for (size_t k = 0; k < v.size(); k += chunk)
+	{
+		vector<V> delta(v.begin() + k, v.begin() + min(v.size(), k + chunk));
+		insert_sorted_batch(sorted, delta);
 	}
+	v.swap(sorted);
+}
 
-	// LSD sort pro heap1
+/**
+ * stream sort
+ * Push v to a Sort_Stream in 8 chunks and take the merged result.
+ * return void
+ */
+template<typename V>
+void streamSort(vector<V>& v)
+{
+	Sort_Stream<V, Sort_Stats_Null, decltype(&onPool)> stream(onPool);
+	const size_t chunk = v.size() / 8 + 1;
+	for (size_t k = 0; k < v.size(); k += chunk)
+		stream.push(v.begin() + k, v.begin() + min(v.size(), k + chunk));
+	v = stream.finish();
+}
+
+/**
+ * algorithms
+ * Every public sort entry point that accepts V,
+ * with std::sort and std::stable_sort as baselines.
+ * Quadratic algorithms are limited to sizes that finish in seconds.
+ * return vector<Algorithm<V>>
+ */
+template<typename V>
+vector<Algorithm<V>> algorithms()
+{
+	using C = vector<V>;
+	vector<Algorithm<V>> list{
+		{ "std::sort",                    no_limit, no_limit, [](C& v) { sort(v.begin(), v.end()); } },
+		{ "std::stable_sort",             no_limit, no_limit, [](C& v) { stable_sort(v.begin(), v.end()); } },
+		{ "bubble_sort",                  10000,    10000,    [](C& v) { bubble_sort(v); } },
+		{ "bubble_sort(ptr)",             10000,    10000,    [](C& v) { bubble_sort(v.data(), v.data() + v.size()); } },
+		{ "insertion_sort",               20000,    20000,    [](C& v) { insertion_sort(v); } },
+		{ "insertion_sort(ptr)",          20000,    20000,    [](C& v) { insertion_sort(v.data(), v.data() + v.size()); } },
+		{ "quick_sort",                   no_limit, 10000,    [](C& v) { quick_sort(v); } },
+		{ "quick_sort_pro",               no_limit, 10000,    [](C& v) { quick_sort_pro(v); } },
+		{ "quick_sort_pro(ptr)",          no_limit, 10000,    [](C& v) { quick_sort_pro(v.data(), v.data() + v.size()); } },
+		{ "quick_sort_pro_safe",          no_limit, no_limit, [](C& v) { quick_sort_pro_safe(v); } },
+		{ "quick_sort_pro_safe(ptr)",     no_limit, no_limit, [](C& v) { quick_sort_pro_safe(v.data(), v.data() + v.size()); } },
+		{ "heap_sort",                    no_limit, no_limit, [](C& v) { heap_sort(v); } },
+		{ "heap_sort(ptr)",               no_limit, no_limit, [](C& v) { heap_sort(v.data(), v.data() + v.size()); } },
+		{ "sort_network",                 16,       16,       [](C& v) { networkSort<16>(v); } },
+		{ "merge_sort",                   no_limit, no_limit, [](C& v) { merge_sort(v); } },
+		{ "list_sort",                    no_limit, no_limit, [](C& v) { std::list<V> l(v.begin(), v.end()); list_sort(l); v.assign(l.begin(), l.end()); } },
+		{ "list_sort(forward_list)",      no_limit, no_limit, [](C& v) { forward_list<V> l(v.begin(), v.end()); list_sort(l); v.assign(l.begin(), l.end()); } },
+		{ "argsort",                      no_limit, no_limit, [](C& v) { apply_permutation(argsort(v), v); } },
+		{ "argsort_columns",              no_limit, no_limit, [](C& v) { apply_permutation(argsort_columns(v), v); } },
+		{ "sort_columns",                 no_limit, no_limit, [](C& v) { sort_columns(v); } },
+		{ "sort_batch",                   no_limit, no_limit, [](C& v) { sort_batch(v, max<size_t>(v.size(), 1)); } },
+		{ "sort_lazy",                    no_limit, no_limit, [](C& v) { for (const auto& c : sort_lazy(v)) (void)c; } },
+		{ "parallel_merge_sort",          no_limit, no_limit, [](C& v) { parallel_merge_sort(v); } },
+		{ "parallel_sample_sort",         no_limit, no_limit, [](C& v) { parallel_sample_sort(v); } },
+		{ "sort_copy",                    no_limit, no_limit, [](C& v) { C dst; sort_copy(v, dst); v.swap(dst); } },
+		{ "segmented_sort",               no_limit, no_limit, [](C& v) { segmented_sort(v, { 0, v.size() }); } },
+		{ "segmented_sort(1)",            no_limit, no_limit, [](C& v) { segmented_sort(v, { 0, v.size() }, 1); } },
+		{ "insert_sorted_batch",          no_limit, no_limit, [](C& v) { batchSort(v); } },
+		{ "sort_async",                   no_limit, no_limit, [](C& v) { sort_async(v, onPool).get(); } },
+		{ "Sort_Stream",                  no_limit, no_limit, [](C& v) { streamSort(v); } },
+	};
+	// Equal keys of kv may hold different values, so which one is distinct is not defined.
+	if constexpr (!is_same<V, Key_Value>::value)
+	{
+		vector<Algorithm<V>> group{
+			{ "sort_unique",              no_limit, no_limit, [](C& v) { v = sort_unique(v); }, true },
+			{ "sort_count",               no_limit, no_limit, [](C& v) { countSort(v); } },
+		};
+		list.insert(list.end(), group.begin(), group.end());
+	}
+	// the radix sorts reject the other integers, such as char16_t
+	if constexpr (radix_integral<V>::value)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "LSD_sort_pro_heap1: ";
+		vector<Algorithm<V>> radix{
+			{ "LSD_sort",                 no_limit, no_limit, [](C& v) { LSD_sort(v); } },
+			{ "LSD_sort_pro",             no_limit, no_limit, [](C& v) { LSD_sort_pro(v); } },
+			{ "LSD_sort_pro_heap1",       no_limit, no_limit, [](C& v) { LSD_sort_pro_heap1(v); } },
+			{ "LSD_sort_pro_heap2",       no_limit, no_limit, [](C& v) { LSD_sort_pro_heap2(v); } },
+			{ "LSD_sort_pro_heap1(0)",    no_limit, no_limit, [](C& v) { LSD_sort_pro_heap1(v, 0); } }, // no scratch: in place
+			{ "LSD_sort_pro_heap1(n)",    no_limit, no_limit, [](C& v) { LSD_sort_pro_heap1(v, v.size() * sizeof(V)); } }, // one copy: the heap2 passes
+			{ "LSD_sort_pro_heap2(0)",    no_limit, no_limit, [](C& v) { LSD_sort_pro_heap2(v, 0); } }, // no scratch: in place
+			{ "counting_sort_direct",     no_limit, no_limit, [](C& v) { countingSort(v); } },
+			{ "MSD_sort",                 no_limit, no_limit, [](C& v) { MSD_sort(v); } },
+			{ "MSD_sort_pro",             no_limit, no_limit, [](C& v) { MSD_sort_pro(v); } },
+			{ "radix_sort_copy",          no_limit, no_limit, [](C& v) { C dst; radix_sort_copy(v, dst); v.swap(dst); } },
+		};
+		list.insert(list.end(), radix.begin(), radix.end());
+	}
+	return list;
+}
+
+#if __cplusplus >= 202002L
+// Under C++20 the small sorts are constexpr: the compiler sorts these tables,
+// so a sort that stops being constexpr, or sorts wrongly, breaks the build.
+template<size_t N, typename Sort>
+constexpr array<int, N> compileTimeTable(Sort sort)
+{
+	array<int, N> table{};
+	for (size_t i = 0; i != N; i++) table[i] = static_cast<int>((i * 37 + 11) % 53) - 20;
+	sort(table);
+	return table;
+}
+
+template<size_t N>
+constexpr array<int, N> compileTimeReference = compileTimeTable<N>([](auto& a) { sort(a.begin(), a.end()); });
+
+static_assert(compileTimeTable<40>([](auto& a) { quick_sort_pro_safe(a); }) == compileTimeReference<40>);
+static_assert(compileTimeTable<40>([](auto& a) { heap_sort(a); }) == compileTimeReference<40>);
+static_assert(compileTimeTable<40>([](auto& a) { insertion_sort(a); }) == compileTimeReference<40>);
+static_assert(compileTimeTable<1>([](auto& a) { sort_network(a); }) == compileTimeReference<1>);
+static_assert(compileTimeTable<13>([](auto& a) { sort_network(a); }) == compileTimeReference<13>);
+static_assert(compileTimeTable<32>([](auto& a) { sort_network(a); }) == compileTimeReference<32>);
+
+// the network for N elements sorts all the 2^N inputs of zeros and ones (so every input)
+template<size_t N>
+constexpr bool compileTimeNetworkSortsAll()
+{
+	for (unsigned bits = 0; bits != 1u << N; bits++)
+	{
+		array<int, N> a{};
+		for (size_t i = 0; i != N; i++) a[i] = bits >> i & 1;
+		sort_network(a);
+		for (size_t i = 1; i != N; i++)
+			if (a[i] < a[i - 1]) return false;
+	}
+	return true;
+}
+static_assert(compileTimeNetworkSortsAll<10>());
+#endif // C++20
+
+// the checksum of a whole container
+template<typename V>
+uint64_t checksum(const vector<V>& data)
+{
+	uint64_t sum = 0;
+	for (const auto& c : data)
+	{
+		if constexpr (is_integral<V>::value) sum += hashOf(static_cast<int64_t>(c));
+		else if constexpr (is_floating_point<V>::value) sum += hashOf(static_cast<double>(c));
+		else sum += hashOf(c);
+	}
+	return sum;
+}
+
+// the q-quantile (nearest rank) of the sorted samples
+double quantile(const vector<double>& sorted_samples, double q)
+{
+	size_t rank = static_cast<size_t>(ceil(q * sorted_samples.size()));
+	return sorted_samples[min(sorted_samples.size(), max<size_t>(rank, 1)) - 1];
+}
+
+/**
+ * same as std::sort
+ * Check the result against the output of std::sort:
+ * every element must be equivalent to the one at the same place,
+ * and the checksum makes sure that it is a permutation of the input.
+ * (Equal keys with different values may be in any order.)
+ * return bool
+ */
+template<typename V>
+bool sameAsStdSort(const vector<V>& result, const vector<V>& reference, uint64_t ck)
+{
+	if (result.size() != reference.size()) return false;
+	for (size_t i = 0; i != result.size(); i++)
+	{
+		if (result[i] < reference[i] || reference[i] < result[i]) return false;
+	}
+	return checksum(result) == ck;
+}
+
+/**
+ * measure
+ * Run one algorithm on copies of data (warm-up first),
+ * and verify the last result against reference (sorted by std::sort, or only its distinct elements).
+ * return Result
+ */
+template<typename V>
+Result measure(const Algorithm<V>& algo, const vector<V>& data, const vector<V>& reference, uint64_t ck, const Options& opt)
+{
+	// Small inputs are sorted in batches of copies,
+	// so that every timed region is long enough to be measured.
+	const size_t n = data.size();
+	const size_t batch = max<size_t>(1, 65536 / max<size_t>(n, 1));
+	TVJ_Timer timer("s.9");
+	vector<double> samples;
+	vector<vector<V>> copies;
+	for (size_t rep = 0; rep != opt.warmup + opt.reps; rep++)
+	{
+		copies.assign(batch, data);
 		timer.restart();
-		LSD_sort_pro_heap1(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		for (auto& c : copies)
+			algo.run(c);
+		double seconds = timer.durationTimeDouble() / batch;
+		if (rep >= opt.warmup) samples.push_back(seconds);
+	}
+	sort(samples.begin(), samples.end());
+	const auto& sorted_copy = copies.back();
+	bool verified = sameAsStdSort(sorted_copy, reference, ck);
+	double median = quantile(samples, 0.5);
+	Result result{ "", "", n, algo.name, opt.reps, median * 1E3, quantile(samples, 0.95) * 1E3,
+		median > 0 ? n / median : 0, verified, {} };
+	for (auto& c : result.perf) c = -1;
+	if (opt.perf)
+	{
+		// one more run with the hardware counters
+		static TVJ_Perf_Counter counter;
+		copies.assign(batch, data);
+		counter.start();
+		for (auto& c : copies)
+			algo.run(c);
+		counter.stop();
+		for (int i = 0; i != TVJ_Perf_Counter::event_count; i++)
+		{
+			long long value = counter.value(static_cast<TVJ_Perf_Counter::Event>(i));
+			result.perf[i] = value < 0 ? -1 : value / static_cast<long long>(batch);
+		}
 	}
+	return result;
+}
+
+// the key of a case in the baseline file
+string caseKey(const string& type, const string& dist, size_t size, const string& algo)
+{
+	return type + ',' + dist + ',' + to_string(size) + ',' + algo;
+}
+
+// whether the user asked for the algorithm
+bool selected(const Options& opt, const string& name)
+{
+	return opt.algos.empty() || find(opt.algos.begin(), opt.algos.end(), name) != opt.algos.end();
+}
 
-	// LSD sort pro heap2
+/**
+ * benchmark type
+ * Benchmark every distribution and size for one element type.
+ * return void
+ */
+template<typename V>
+void benchmarkType(const string& type, const Options& opt, vector<Result>& results)
+{
+	auto algos = algorithms<V>();
+	for (const auto& dist : opt.dists)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "LSD_sort_pro_heap2: ";
-		if (length > 20000000)
+		for (auto n : opt.sizes)
 		{
-			cout << "(skipped) The number of elements is too large." << endl;
+			auto data = generate<V>(dist, n, opt.seed);
+			auto ck = checksum(data);
+			auto reference = data;
+			sort(reference.begin(), reference.end());
+			auto distinct = reference;
+			distinct.erase(unique(distinct.begin(), distinct.end()), distinct.end());
+			auto distinct_ck = checksum(distinct);
+			for (const auto& algo : algos)
+			{
+				if (!selected(opt, algo.name)) continue;
+				if (n > (dist == "uniform" ? algo.max_n : algo.max_n_structured)) continue;
+				if (!opt.only.empty() && !opt.only.count(caseKey(type, dist, n, algo.name))) continue;
+				auto result = algo.distinct ? measure(algo, data, distinct, distinct_ck, opt) : measure(algo, data, reference, ck, opt);
+				result.type = type;
+				result.dist = dist;
+				results.push_back(result);
+				cerr << setw(8) << type << setw(9) << dist << setw(11) << n << "  "
+					<< setw(26) << left << algo.name << right << setw(12) << result.median_ms << " ms"
+					<< (result.verified ? "" : "  (failed)") << endl;
+			}
 		}
-		else
+	}
+}
+
+// the column name of a hardware counter
+string perfColumn(int i)
+{
+	static const char* names[TVJ_Perf_Counter::event_count] = { "cycles", "instructions", "llc_misses", "dtlb_misses", "branch_misses" };
+	return names[i];
+}
+
+// print the results in CSV
+void printCsv(ostream& out, const vector<Result>& results, bool with_perf)
+{
+	out << "type,distribution,size,algorithm,reps,median_ms,p95_ms,elements_per_sec,verified";
+	for (int i = 0; with_perf && i != TVJ_Perf_Counter::event_count; i++) out << ',' << perfColumn(i);
+	out << '\n' << setprecision(9);
+	for (const auto& r : results)
+	{
+		out << r.type << ',' << r.dist << ',' << r.size << ',' << r.algo << ',' << r.reps << ','
+			<< r.median_ms << ',' << r.p95_ms << ',' << r.elements_per_sec << ',' << r.verified;
+		for (int i = 0; with_perf && i != TVJ_Perf_Counter::event_count; i++) out << ',' << r.perf[i];
+		out << '\n';
+	}
+}
+
+// print the results in JSON
+void printJson(ostream& out, const vector<Result>& results, bool with_perf)
+{
+	out << "[\n" << setprecision(9);
+	for (size_t i = 0; i != results.size(); i++)
+	{
+		const auto& r = results[i];
+		out << "  {\"type\": \"" << r.type << "\", \"distribution\": \"" << r.dist
+			<< "\", \"size\": " << r.size << ", \"algorithm\": \"" << r.algo
+			<< "\", \"reps\": " << r.reps << ", \"median_ms\": " << r.median_ms
+			<< ", \"p95_ms\": " << r.p95_ms << ", \"elements_per_sec\": " << r.elements_per_sec
+			<< ", \"verified\": " << (r.verified ? "true" : "false");
+		for (int k = 0; with_perf && k != TVJ_Perf_Counter::event_count; k++)
 		{
-			timer.restart();
-			LSD_sort_pro_heap2(temp_vec);
-			double duration_time = timer.durationTimeDouble();
-			checkSorted(temp_vec, ck);
-			cout << duration_time << " seconds." << endl;
+			// an unavailable counter is null
+			out << ", \"" << perfColumn(k) << "\": ";
+			if (r.perf[k] < 0) out << "null";
+			else out << r.perf[k];
 		}
-		// _print_vec;
+		out << '}' << (i + 1 == results.size() ? "\n" : ",\n");
 	}
+	out << "]\n";
+}
+
+/**
+ * regression matrix
+ * Set the fixed matrix of the regression check.
+ * return void
+ */
+void regressionMatrix(Options& opt)
+{
+	// int16 is counted directly at 100000 elements (counting_sort_direct)
+	opt.types = { "int16", "int32", "int64", "char16", "double", "string" };
+	opt.dists = { "uniform", "sorted", "few", "zipf" };
+	// the small sizes take the insertion sort paths of the radix sorts, over the full range of values
+	opt.sizes = { 4, 12, 1000, 100000 };
+	opt.algos = { "std::sort", "std::stable_sort", "insertion_sort", "quick_sort_pro_safe", "heap_sort",
+		"merge_sort", "parallel_merge_sort", "parallel_sample_sort",
+		"LSD_sort", "LSD_sort_pro", "LSD_sort_pro_heap1", "LSD_sort_pro_heap2", "MSD_sort", "MSD_sort_pro",
+		"LSD_sort_pro_heap1(0)", "LSD_sort_pro_heap1(n)", "LSD_sort_pro_heap2(0)", "counting_sort_direct" };
+	opt.reps = max<size_t>(opt.reps, 7);
+}
 
-	// LSD sort pro
+/**
+ * write baseline
+ * Write the baseline from two runs of the matrix: the slower median,
+ * with a tolerance per case of 25% (50% below 1 ms, where the timer
+ * and the caches are noisier), or three times the spread (p95 / median),
+ * or twice the difference of the two runs if it is larger.
+ * return bool
+ */
+bool writeBaseline(const string& path, const vector<Result>& first, const vector<Result>& second)
+{
+	ofstream file(path);
+	if (!file) return false;
+	file << "type,distribution,size,algorithm,median_ms,tolerance\n" << setprecision(6);
+	for (size_t i = 0; i != first.size() && i != second.size(); i++)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "LSD_sort_pro: ";
-		timer.restart();
-		LSD_sort_pro(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		const auto& r = first[i].median_ms < second[i].median_ms ? second[i] : first[i];
+		double fast = min(first[i].median_ms, second[i].median_ms);
+		double spread = r.median_ms > 0 ? r.p95_ms / r.median_ms - 1 : 0;
+		double drift = fast > 0 ? r.median_ms / fast - 1 : 0;
+		double tolerance = max({ r.median_ms < 1 ? 0.5 : 0.25, 3 * spread, 2 * drift });
+		file << caseKey(r.type, r.dist, r.size, r.algo) << ',' << r.median_ms << ',' << tolerance << '\n';
 	}
+	return true;
+}
 
-	// LSD sort
+// the baseline: case -> (median_ms, tolerance)
+typedef map<string, pair<double, double>> Baseline;
+
+/**
+ * read baseline
+ * Read the file written by writeBaseline.
+ * return bool
+ */
+bool readBaseline(const string& path, Baseline& baseline)
+{
+	ifstream file(path);
+	if (!file) return false;
+	string line;
+	getline(file, line); // the header
+	while (getline(file, line))
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "LSD_sort: ";
-		timer.restart();
-		LSD_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		auto parts = split(line);
+		if (parts.size() != 6) continue;
+		baseline[caseKey(parts[0], parts[1], stoul(parts[2]), parts[3])] = { stod(parts[4]), stod(parts[5]) };
 	}
+	return true;
+}
 
-	// MSD sort pro
+/**
+ * machine factor
+ * The median ratio (now / baseline) of all the cases,
+ * so that a faster or busier machine does not fail the whole matrix.
+ * return double
+ */
+double machineFactor(const Baseline& baseline, const vector<Result>& results)
+{
+	vector<double> ratios;
+	for (const auto& r : results)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "MSD_sort_pro: ";
-		timer.restart();
-		MSD_sort_pro(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		auto iter = baseline.find(caseKey(r.type, r.dist, r.size, r.algo));
+		if (iter != baseline.end() && iter->second.first > 0) ratios.push_back(r.median_ms / iter->second.first);
 	}
+	sort(ratios.begin(), ratios.end());
+	return ratios.empty() ? 1 : quantile(ratios, 0.5);
+}
 
-	// MSD sort
+// whether a case got slower than the others by more than its tolerance
+bool isSlower(const Baseline& baseline, const Result& r, double machine)
+{
+	auto iter = baseline.find(caseKey(r.type, r.dist, r.size, r.algo));
+	return iter != baseline.end() && r.median_ms > iter->second.first * machine * (1 + iter->second.second);
+}
+
+/**
+ * check baseline
+ * Compare the results with the baseline and print the cases
+ * that are slower, wrong, or not in the baseline.
+ * return bool (true if nothing is slower or wrong)
+ */
+bool checkBaseline(const string& path, const Baseline& baseline, const vector<Result>& results, ostream& out)
+{
+	double machine = machineFactor(baseline, results);
+	size_t slower = 0, wrong = 0, missing = 0;
+	out << "Regression check against " << path << fixed << setprecision(2)
+		<< " (this machine takes " << machine << "x the baseline time)\n";
+	for (const auto& r : results)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "MSD_sort: ";
-		timer.restart();
-		MSD_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		auto iter = baseline.find(caseKey(r.type, r.dist, r.size, r.algo));
+		string status = "ok";
+		double base = 0, tolerance = 0, change = 0;
+		if (!r.verified)
+		{
+			status = "WRONG (differs from std::sort)";
+			wrong++;
+		}
+		if (iter == baseline.end())
+		{
+			if (r.verified) status = "no baseline";
+			missing++;
+		}
+		else
+		{
+			base = iter->second.first;
+			tolerance = iter->second.second;
+			change = base > 0 ? r.median_ms / (base * machine) - 1 : 0;
+			if (r.verified && isSlower(baseline, r, machine))
+			{
+				status = "SLOWER";
+				slower++;
+			}
+		}
+		// only the cases that need attention, and the summary
+		if (status == "ok") continue;
+		out << "  " << setw(7) << left << r.type << setw(9) << r.dist << right << setw(7) << r.size << "  "
+			<< setw(22) << left << r.algo << right << setprecision(3) << setw(10) << base << " ms ->"
+			<< setw(10) << r.median_ms << " ms " << showpos << setprecision(1) << setw(8) << 100 * change
+			<< "% (limit " << 100 * tolerance << "%)" << noshowpos << "  " << status << '\n';
 	}
+	out << results.size() << " cases: " << slower << " slower, " << wrong << " wrong, "
+		<< missing << " without baseline" << endl;
+	return !slower && !wrong;
+}
 
-	// quick sort pro safe
+/**
+ * run benchmark
+ * Measure every type, distribution, size and algorithm in opt.
+ * return void
+ */
+void runBenchmark(const Options& opt, vector<Result>& results)
+{
+	for (const auto& type : opt.types)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Quick_sort_pro_safe: ";
-		timer.restart();
-		quick_sort_pro_safe(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		if      (type == "int8")   benchmarkType<int8_t>(type, opt, results);
+		else if (type == "int16")  benchmarkType<int16_t>(type, opt, results);
+		else if (type == "int32")  benchmarkType<int32_t>(type, opt, results);
+		else if (type == "int64")  benchmarkType<int64_t>(type, opt, results);
+		else if (type == "char16") benchmarkType<char16_t>(type, opt, results);
+		else if (type == "float")  benchmarkType<float>(type, opt, results);
+		else if (type == "double") benchmarkType<double>(type, opt, results);
+		else if (type == "string") benchmarkType<string>(type, opt, results);
+		else if (type == "kv")     benchmarkType<Key_Value>(type, opt, results);
+		else cerr << "Unknown type " << type << endl;
 	}
+}
 
-	// quick sort pro
+/**
+ * confirm slower
+ * Measure the cases that look slower again (up to twice) and keep
+ * the better median, so that a burst of noise on the machine
+ * does not fail the check; a real regression is slower every time.
+ * return void
+ */
+void confirmSlower(Options opt, const Baseline& baseline, vector<Result>& results)
+{
+	for (int round = 0; round != 2; round++)
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Quick_sort_pro: ";
-		timer.restart();
-		quick_sort_pro(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		double machine = machineFactor(baseline, results);
+		opt.only.clear();
+		for (const auto& r : results)
+			if (r.verified && isSlower(baseline, r, machine)) opt.only.insert(caseKey(r.type, r.dist, r.size, r.algo));
+		if (opt.only.empty()) return;
+		cerr << "Measuring " << opt.only.size() << " slower case(s) again" << endl;
+		vector<Result> again;
+		runBenchmark(opt, again);
+		for (const auto& a : again)
+		{
+			for (auto& r : results)
+			{
+				if (caseKey(r.type, r.dist, r.size, r.algo) != caseKey(a.type, a.dist, a.size, a.algo)) continue;
+				if (a.median_ms < r.median_ms || !a.verified) r = a;
+			}
+		}
 	}
+}
 
-	// quick sort
+int main(int argc, char** argv)
+{
+	Options opt;
+	if (!parseOptions(argc, argv, opt))
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Quick_sort: ";
-		timer.restart();
-		quick_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		cerr << "Usage: " << argv[0] << " [--types t,...] [--dists d,...] [--sizes n,...] [--algos a,...]\n"
+			<< "       [--reps 5] [--warmup 1] [--seed 2021] [--format csv|json] [--out file] [--perf]\n"
+			<< "       [--check baseline.csv | --write-baseline baseline.csv]" << endl;
+		return 2;
 	}
+	const bool regression = !opt.check.empty() || !opt.write_baseline.empty();
+	if (regression) regressionMatrix(opt);
 
-	// heap sort
+	if (opt.perf && !TVJ_Perf_Counter().available())
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Heap_sort: ";
-		timer.restart();
-		heap_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		cerr << "Hardware counters are unavailable (see /proc/sys/kernel/perf_event_paranoid)." << endl;
 	}
 
-	// insertion sort
+	Baseline baseline;
+	if (!opt.check.empty() && !readBaseline(opt.check, baseline))
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Insertion_sort: ";
-		timer.restart();
-		insertion_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		cerr << "Can not open the baseline " << opt.check << endl;
+		return 2;
 	}
 
-	// bubble sort
+	vector<Result> results;
+	runBenchmark(opt, results);
+	if (!opt.check.empty()) confirmSlower(opt, baseline, results);
+
+	// The regression check prints its report instead of the results,
+	// which can still be written with --out.
+	ofstream file;
+	if (!opt.out.empty()) file.open(opt.out);
+	ostream& out = opt.out.empty() ? cout : file;
+	if (!regression || !opt.out.empty())
 	{
-		vector<int> temp_vec = ran;
-		cout << setw(21) << "Bubble_sort: ";
-		timer.restart();
-		bubble_sort(temp_vec);
-		double duration_time = timer.durationTimeDouble();
-		checkSorted(temp_vec, ck);
-		cout << duration_time << " seconds." << endl;
-		// _print_vec;
+		if (opt.format == "json") printJson(out, results, opt.perf);
+		else printCsv(out, results, opt.perf);
 	}
+	if (!opt.write_baseline.empty())
+	{
+		cerr << "Measuring the matrix again for the baseline" << endl;
+		vector<Result> second;
+		runBenchmark(opt, second);
+		if (!writeBaseline(opt.write_baseline, results, second))
+		{
+			cerr << "Can not write the baseline " << opt.write_baseline << endl;
+			return 2;
+		}
+		cerr << "Baseline written to " << opt.write_baseline << endl;
+	}
+	if (!opt.check.empty() && !checkBaseline(opt.check, baseline, results, cout))
+	{
+		return 1;
+	}
+
+#ifdef TVJ_SORT_PROFILE
+	// the phases of the radix sorts, summed over all the runs
+	TVJ_Phases::report(cerr);
+#endif
 
-	return 0;
+	bool all_verified = true;
+	for (const auto& r : results) all_verified = all_verified && r.verified;
+	return all_verified ? 0 : 1;
 }
 
-// ALL RIGHTS RESERVED (C) 2021 Teddy van Jerry
\ No newline at end of file
+// ALL RIGHTS RESERVED (C) 2021 Teddy van Jerry
@@ -0,0 +1,128 @@
+/*
+ * File: Sample3.cpp
+ * --------------------
+ *
+ * @author: Teddy van Jerry
+ * @licence: The MIT Licence
+ * @compiler: At least C++/14, POSIX (Linux)
+ *
+ * @version 2026/10/19
+ * - Initial version
+ *
+ * @note: This sample runs dist_sort (TVJ_Sort_Dist.h) on local processes.
+ *
+ * Options:
+ *   --processes 4        (the number of processes, forked from this one)
+ *   --size      1000000  (the elements of every shard)
+ *   --tcp       port     (connect by TCP on 127.0.0.1:port, port + 1, ...
+ *                         instead of Unix sockets)
+ *   --seed      2021
+ *
+ * Every process generates its shard, the shards are sorted together,
+ * and rank 0 prints the size and the range of every shard.
+ * The exit code is 0 if the result is sorted and nothing is lost.
+ *
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include "TVJ_Sort.h"
+#include "TVJ_Sort_Dist.h"
+#include "TVJ_Timer.h"
+using namespace std;
+
+// what every rank reports to rank 0
+struct Report
+{
+	uint64_t size;
+	uint64_t checksum;
+	int64_t first;
+	int64_t last;
+	double seconds;
+};
+
+int main(int argc, char** argv)
+{
+	int processes = 4, port = 0;
+	size_t size = 1000000;
+	uint64_t seed = 2021;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string key = argv[i], value = argv[i + 1];
+		if (key == "--processes") processes = atoi(value.c_str());
+		else if (key == "--size") size = static_cast<size_t>(atof(value.c_str()));
+		else if (key == "--tcp") port = atoi(value.c_str());
+		else if (key == "--seed") seed = strtoull(value.c_str(), nullptr, 10);
+		else
+		{
+			cerr << "Usage: " << argv[0] << " [--processes 4] [--size 1e6] [--tcp port] [--seed 2021]" << endl;
+			return 2;
+		}
+	}
+	if (processes < 1) processes = 1;
+
+	Sort_Dist_Group group;
+	int rank = port ? group.fork_tcp(processes, port) : group.fork_local(processes);
+	if (rank < 0)
+	{
+		cerr << "Can not start the processes." << endl;
+		return 1;
+	}
+
+	// every shard is different, and skewed towards small numbers
+	mt19937_64 engine(seed + rank);
+	uniform_int_distribution<int64_t> small(-1000, 1000);
+	vector<int64_t> shard(size);
+	uint64_t checksum = 0;
+	for (auto& c : shard)
+	{
+		c = engine() % 4 ? small(engine) : static_cast<int64_t>(engine());
+		checksum += static_cast<uint64_t>(c);
+	}
+
+	TVJ_Timer timer("s.3");
+	bool ok = dist_sort(group, shard);
+	Report mine{ shard.size(), 0, 0, 0, timer.durationTimeDouble() };
+	for (auto c : shard)
+		mine.checksum += static_cast<uint64_t>(c);
+	if (!shard.empty())
+	{
+		mine.first = shard.front();
+		mine.last = shard.back();
+	}
+	ok = ok && dist_is_sorted(group, shard);
+
+	// the sum of all the elements does not change
+	vector<vector<char>> all;
+	vector<char> sums = dist_bytes(&checksum, 1), after = dist_bytes(&mine, 1);
+	vector<vector<char>> before_all;
+	ok = ok && group.all_gather(sums, before_all) && group.all_gather(after, all);
+
+	if (rank != 0) return ok ? 0 : 1;
+
+	uint64_t total_before = 0, total_after = 0, elements = 0;
+	for (int r = 0; ok && r != processes; r++)
+	{
+		uint64_t sum;
+		Report report;
+		memcpy(&sum, before_all[r].data(), sizeof(sum));
+		memcpy(&report, all[r].data(), sizeof(report));
+		total_before += sum;
+		total_after += report.checksum;
+		elements += report.size;
+		cout << "rank " << r << ": " << report.size << " elements in [" << report.first << ", "
+			<< report.last << "], " << report.seconds << " s" << endl;
+	}
+	ok = ok && total_before == total_after && elements == size * processes;
+	ok = group.wait() && ok;
+	cout << (ok ? "sorted" : "FAILED") << " (" << processes << " processes, "
+		<< (port ? "TCP" : "Unix sockets") << ")" << endl;
+	return ok ? 0 : 1;
+}
+
+// ALL RIGHTS RESERVED (C) 2021 Teddy van Jerry
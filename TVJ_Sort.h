@@ -4,7 +4,41 @@
  * 
  * @author: Teddy van Jerry
  * @licence: The MIT Licence
- * @compiler: At least C++/11
+ * @compiler: At least C++/14 (C++/20 for the constexpr sorts)
+ * 
+ * @version 2.7 2026/10/19
+ * - Add list_sort (stable merge sort of std::list and std::forward_list by relinking the nodes)
+ * - Sort std::deque through a contiguous copy, and write the radix passes back sequentially
+ * - Add argsort and apply_permutation
+ * - Add merge_sort and parallel_merge_sort (stable, merge path partitioning)
+ * - insertion_sort moves the elements instead of copying them
+ * - Add parallel_sample_sort (NUMA-aware on Linux)
+ * - Add sort_async and Sort_Stream (sorting the chunks while they arrive)
+ * - Add insert_sorted_batch
+ * - Add sort_batch (many small arrays in a flat buffer, by sorting networks across them)
+ * - Add segmented_sort (segments by size class, tasks balanced by elements)
+ * - The radix sorts take a scratch memory budget, and sort in place when it is too small
+ * - LSD_sort_pro_heap2 counts the digits first and scatters into one array of the input size
+ * - The radix sorts count keys of a small range directly (counting_sort_direct)
+ * - Add sort_unique and sort_count (group by)
+ * - Add sort_copy, radix_sort_copy and merge_sort_copy (sorting into another vector)
+ * - insertion_sort, quick_sort_pro_safe and heap_sort are constexpr under C++20 (TVJ_CONSTEXPR20)
+ * - Add sort_network (fixed-size sorting networks built at compile time)
+ * - Add Sort_Lazy and sort_lazy (incremental quicksort, sorting only as far as it is read)
+ * - Optional software write-combining in the heap radix scatters (TVJ_SORT_WRITE_COMBINE, TVJ_SORT_STREAMING_STORES)
+ * - Add Sort_Deadline, Sort_Stats_Deadline and sort_deadline (deadlines, cancellation and progress of the long sorts)
+ * - Add argsort_columns and sort_columns (multi-column lexicographic sort of columnar tables)
+ * - Add Sort_Pool (one shared pool of work-stealing threads for all the parallel sorts)
+ * 
+ * @version 2.6 2026/10/19
+ * - Add the statistics policy (Sort_Stats_Null, Sort_Stats_Count)
+ * - Radix passes with all elements in one bucket skip the copy back
+ * 
+ * @version 2.5 2026/10/19
+ * - Bug fix (builds with GCC and Clang)
+ * - Bug fix (radix sorts over the full range of signed types)
+ * - Bug fix (heap_sort of some sizes and the pointer version)
+ * - Bug fix (MSD sorts no longer recurse into empty buckets)
  * 
  * @version 2.4 2021/06/11
  * - Add the pointer version of heap_sort
@@ -30,14 +64,299 @@
 
 #pragma once
 
+#ifndef _TVJ_SORT_STATS_
+#define _TVJ_SORT_STATS_
+#include <cstddef>
+#include <ostream>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+/**
+ * Sort_Stats_Null
+ * The default statistics policy of the sorts.
+ * Every hook is empty and 'enabled' is false,
+ * so the sorts compile to the uninstrumented code.
+ * The hooks are constexpr, so that the sorts can run at compile time.
+ */
+struct Sort_Stats_Null
+{
+	static const bool enabled = false;
+	template<typename V> static constexpr bool less(const V& a, const V& b)          { return a < b; }
+	template<typename V> static constexpr bool greater(const V& a, const V& b)       { return a > b; }
+	template<typename V> static constexpr bool less_equal(const V& a, const V& b)    { return a <= b; }
+	template<typename V> static constexpr bool greater_equal(const V& a, const V& b) { return a >= b; }
+	static constexpr void swap() { }
+	static constexpr void move(size_t = 1) { }
+	static constexpr void pass(bool) { }
+	static constexpr void buckets(size_t, size_t, size_t) { }
+	static constexpr void allocate(size_t) { }
+	// the long sorts give up (leaving a permutation of the input) once stop() is true
+	static constexpr bool stop() { return false; }
+	static constexpr void progress(size_t, size_t) { }
+	// put one in each recursive call to count the recursion depth
+	struct Depth
+	{
+		constexpr Depth() { }
+	};
+};
+
+/**
+ * Sort_Counters
+ * The counters of Sort_Stats_Count.
+ */
+struct Sort_Counters
+{
+	unsigned long long comparisons = 0;    // calls of <, >, <= and >=
+	unsigned long long swaps = 0;          // calls of my_swap
+	unsigned long long moves = 0;          // other element assignments
+	unsigned long long passes_taken = 0;   // radix passes that moved the elements
+	unsigned long long passes_skipped = 0; // radix passes with all elements in one bucket
+	unsigned long long allocations = 0;    // scratch allocations
+	unsigned long long allocated_bytes = 0;
+	size_t depth = 0;                      // the current recursion depth
+	size_t max_depth = 0;
+	double max_bucket_skew = 0;            // the largest bucket / the average bucket
+
+	/**
+	 * reset
+	 * Set all the counters to zero.
+	 * return void
+	 */
+	void reset()
+	{
+		*this = Sort_Counters();
+	}
+};
+
+/**
+ * Overloaded << function to output the counters
+ * return ostream&
+ */
+inline std::ostream& operator<<(std::ostream& out, const Sort_Counters& c)
+{
+	out << "comparisons: " << c.comparisons << ", swaps: " << c.swaps << ", moves: " << c.moves
+		<< ", passes: " << c.passes_taken << " taken / " << c.passes_skipped << " skipped"
+		<< ", max depth: " << c.max_depth << ", max bucket skew: " << c.max_bucket_skew
+		<< ", allocations: " << c.allocations << " (" << c.allocated_bytes << " bytes)";
+	return out;
+}
+
+/**
+ * Sort_Stats_Count
+ * The statistics policy that counts into Sort_Stats_Count::counters(),
+ * one set of counters per thread.
+ * Usage: LSD_sort_pro_heap1<std::vector<int>, Sort_Stats_Count>(vec);
+ */
+struct Sort_Stats_Count
+{
+	static const bool enabled = true;
+
+	/**
+	 * counters
+	 * return Sort_Counters& (of this thread)
+	 */
+	static Sort_Counters& counters()
+	{
+		static thread_local Sort_Counters c;
+		return c;
+	}
+
+	template<typename V> static inline bool less(const V& a, const V& b)          { counters().comparisons++; return a < b; }
+	template<typename V> static inline bool greater(const V& a, const V& b)       { counters().comparisons++; return a > b; }
+	template<typename V> static inline bool less_equal(const V& a, const V& b)    { counters().comparisons++; return a <= b; }
+	template<typename V> static inline bool greater_equal(const V& a, const V& b) { counters().comparisons++; return a >= b; }
+	static inline void swap() { counters().swaps++; }
+	static inline void move(size_t count = 1) { counters().moves += count; }
+	static inline void pass(bool taken) { (taken ? counters().passes_taken : counters().passes_skipped)++; }
+	static inline void allocate(size_t bytes)
+	{
+		counters().allocations++;
+		counters().allocated_bytes += bytes;
+	}
+	static constexpr bool stop() { return false; }
+	static constexpr void progress(size_t, size_t) { }
+
+	/**
+	 * buckets
+	 * Record the skew of one distribution:
+	 * the largest of bucket_count buckets holding total elements.
+	 * return void
+	 */
+	static inline void buckets(size_t largest, size_t total, size_t bucket_count)
+	{
+		if (!total) return;
+		double skew = static_cast<double>(largest) * bucket_count / total;
+		if (skew > counters().max_bucket_skew) counters().max_bucket_skew = skew;
+	}
+
+	struct Depth
+	{
+		Depth()
+		{
+			Sort_Counters& c = counters();
+			if (++c.depth > c.max_depth) c.max_depth = c.depth;
+		}
+		~Depth()
+		{
+			counters().depth--;
+		}
+	};
+};
+
+/**
+ * Sort_Deadline
+ * A deadline and a cancellation flag for the sorts run with Sort_Stats_Deadline,
+ * and a callback told about their progress.
+ * The sorts check it at coarse points (between radix passes and merge levels,
+ * and in the recursion on parts of at least sort_checkpoint elements),
+ * so the check costs nothing measurable, and a sort stops within about
+ * one pass over its data. Once stopped, a sort returns early
+ * and leaves the data a permutation of the input, but not sorted.
+ * A deadline stays stopped until it is set again (until, within or reset),
+ * and sort_deadline resets it before each sort, so it can be reused.
+ * Usage: Sort_Deadline d; d.within(std::chrono::milliseconds(5));
+ *        if (!sort_deadline(d, [&] { LSD_sort_pro_heap1<std::vector<int>, Sort_Stats_Deadline>(vec); })) ...
+ */
+class Sort_Deadline
+{
+public:
+	typedef std::chrono::steady_clock clock;
+	// progress(done, total), in passes or levels of the sort that reports it
+	typedef std::function<void(size_t, size_t)> Progress;
+
+	Sort_Deadline() : deadline_(clock::time_point::max()), cancel_(nullptr), stopped_(false) { }
+
+	// stop at the time point
+	void until(clock::time_point deadline) { deadline_ = deadline; reset(); }
+	// stop after the duration from now on
+	template<typename Duration> void within(Duration duration) { deadline_ = clock::now() + duration; reset(); }
+	// stop once *flag is true (set from any thread)
+	void cancel_on(const std::atomic<bool>* flag) { cancel_ = flag; }
+	void on_progress(Progress progress) { progress_ = progress; }
+	// true if a sort has given up
+	bool stopped() const { return stopped_.load(std::memory_order_relaxed); }
+	// forget that a sort has given up (not while a sort runs under it)
+	void reset() { stopped_.store(false, std::memory_order_relaxed); }
+
+	/**
+	 * check
+	 * Stop if the deadline has passed or the flag is set.
+	 * return true if stopped
+	 */
+	bool check()
+	{
+		if (stopped()) return true;
+		if ((cancel_ && cancel_->load(std::memory_order_relaxed)) || clock::now() >= deadline_)
+		{
+			stopped_.store(true, std::memory_order_relaxed);
+			return true;
+		}
+		return false;
+	}
+
+	void progress(size_t done, size_t total)
+	{
+		if (progress_) progress_(done, total);
+	}
+
+	/**
+	 * current
+	 * return Sort_Deadline*& (the deadline of this thread, nullptr if none)
+	 */
+	static Sort_Deadline*& current()
+	{
+		static thread_local Sort_Deadline* d = nullptr;
+		return d;
+	}
+
+	/**
+	 * reporting
+	 * False in the tasks of a parallel sort, so that only the sort
+	 * called under the deadline reports, from the calling thread.
+	 * return bool& (of this thread)
+	 */
+	static bool& reporting()
+	{
+		static thread_local bool r = true;
+		return r;
+	}
+
+	// install a deadline for this thread while in the scope
+	class Scope
+	{
+	public:
+		explicit Scope(Sort_Deadline* deadline, bool report = true) : previous_(current()), report_(reporting())
+		{
+			current() = deadline;
+			reporting() = report;
+		}
+		~Scope()
+		{
+			current() = previous_;
+			reporting() = report_;
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	private:
+		Sort_Deadline* previous_;
+		bool report_;
+	};
+
+private:
+	clock::time_point deadline_;
+	const std::atomic<bool>* cancel_;
+	Progress progress_;
+	std::atomic<bool> stopped_; // shared by the threads of a parallel sort
+};
+
+/**
+ * Sort_Stats_Deadline
+ * The statistics policy that stops the sorts at the deadline
+ * of this thread (see Sort_Deadline), and counts nothing.
+ */
+struct Sort_Stats_Deadline : Sort_Stats_Null
+{
+	static inline bool stop()
+	{
+		Sort_Deadline* d = Sort_Deadline::current();
+		return d && d->check();
+	}
+	static inline void progress(size_t done, size_t total)
+	{
+		Sort_Deadline* d = Sort_Deadline::current();
+		if (d && Sort_Deadline::reporting()) d->progress(done, total);
+	}
+};
+
+/**
+ * sort deadline
+ * Run sort (a callable, sorting with Sort_Stats_Deadline) under the deadline,
+ * reset first so that an earlier stop does not count.
+ * return true if it sorted completely, false if it stopped
+ */
+template<typename Sort>
+bool sort_deadline(Sort_Deadline& deadline, Sort sort)
+{
+	deadline.reset();
+	Sort_Deadline::Scope scope(&deadline);
+	sort();
+	return !deadline.stopped();
+}
+#endif // !_TVJ_SORT_STATS_
+
 #ifndef _HEAP_VECTOR_
 #define _HEAP_VECTOR_
 
 // A simple vector class that supports limited functions.
-template<typename ValueType>
+// Stats is told about every allocation (see Sort_Stats_Null).
+template<typename ValueType, typename Stats = Sort_Stats_Null>
 class Heap_Vector {
 public:
-	Heap_Vector(size_t n = 32) : capacity_(n), size_(0), vec_(new ValueType[n]) { }
+	Heap_Vector(size_t n = 32) : capacity_(n), size_(0), vec_(new ValueType[n])
+	{
+		Stats::allocate(n * sizeof(ValueType));
+	}
 	~Heap_Vector() // destructor
 	{
 		delete[] vec_; // free the dynamic array
@@ -51,6 +370,17 @@ public:
 		}
 		vec_[size_++] = value;
 	}
+	// push back count values at once
+	void append(const ValueType* values, size_t count)
+	{
+		while (size_ + count > capacity_)
+		{
+			expand();
+		}
+		for (size_t i = 0; i != count; i++)
+			vec_[size_ + i] = values[i];
+		size_ += count;
+	}
 	inline const ValueType& operator [](size_t index) const
 	{
 		return vec_[index];
@@ -74,9 +404,11 @@ protected:
 	{
 		// 1. ask for new space for the array
 		ValueType* new_vec = new ValueType[2 * capacity_];
+		Stats::allocate(2 * capacity_ * sizeof(ValueType));
 		// 2. copy the values over
 		for (size_t i = 0; i != size_; i++)
 			new_vec[i] = vec_[i];
+		Stats::move(size_);
 		// 3. delete the old array
 		delete[] vec_;
 		// 4. point vec to new array
@@ -94,13 +426,64 @@ protected:
 #ifndef _TVJ_SORT_
 #define _TVJ_SORT_
 #include <string>
+#include <vector>
+#include <deque>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <array>
+#include <utility>
+#ifdef __linux__
+#include <sched.h>
+#include <fstream>
+#endif // __linux__
+#if defined (TVJ_SORT_STREAMING_STORES) && !defined (TVJ_SORT_WRITE_COMBINE)
+#define TVJ_SORT_WRITE_COMBINE
+#endif // TVJ_SORT_STREAMING_STORES
+#if defined (TVJ_SORT_STREAMING_STORES) && (defined (__x86_64__) || defined (_M_X64))
+#include <emmintrin.h>
+#include <cstring>
+#endif // TVJ_SORT_STREAMING_STORES
 #define my_max(i, j) ((i > j) ? i : j)
 #define my_min(i, j) ((i < j) ? i : j)
 #define radix_index 256
 #define radix_binary 8
+// the smallest part on which the recursive sorts check Stats::stop()
+#define sort_checkpoint 4096
+
+// the sorts usable at compile time (constexpr from C++20 on)
+#if __cplusplus >= 202002L || (defined (_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#define TVJ_CONSTEXPR20 constexpr
+#else
+#define TVJ_CONSTEXPR20
+#endif // C++20
+
+// Define TVJ_SORT_PROFILE to time the phases of the radix sorts
+// (see TVJ_Phases in TVJ_Timer.h). Otherwise the macros are empty.
+#ifdef TVJ_SORT_PROFILE
+#include "TVJ_Timer.h"
+#define TVJ_SORT_PHASE(name)      TVJ_Phase_Scope tvj_sort_phase_(name)
+#define TVJ_SORT_STEP_FIRST(name) TVJ_Phase_Scope tvj_sort_step_(name)
+#define TVJ_SORT_STEP(name)       tvj_sort_step_.next(name)
+#else
+#define TVJ_SORT_PHASE(name)
+#define TVJ_SORT_STEP_FIRST(name)
+#define TVJ_SORT_STEP(name)
+#endif // TVJ_SORT_PROFILE
 
 #if defined (_WIN64) || defined (WIN32)
 #include <Windows.h>
+#else
+typedef wchar_t WCHAR;
 #endif // only for Windows
 
 // set alias (C++/11)
@@ -109,6 +492,25 @@ template<typename T> using vec_iter     =       typename T::iterator;
 template<typename T> using c_vec_c_iter = const typename T::const_iterator;
 template<typename T> using c_vec_iter   = const typename T::iterator;
 
+/**
+ * radix integral
+ * Whether V is sorted by radix: one of the integer types the radix sorts accept
+ * (bool, wchar_t, char16_t and char32_t are not).
+ */
+template<typename V>
+using radix_integral = std::integral_constant<bool,
+	   std::is_same<typename std::decay<V>::type, char	              >::value
+	|| std::is_same<typename std::decay<V>::type, signed char       >::value
+	|| std::is_same<typename std::decay<V>::type, short	              >::value
+	|| std::is_same<typename std::decay<V>::type, int		          >::value
+	|| std::is_same<typename std::decay<V>::type, long		          >::value
+	|| std::is_same<typename std::decay<V>::type, long long         >::value
+	|| std::is_same<typename std::decay<V>::type, unsigned char     >::value
+	|| std::is_same<typename std::decay<V>::type, unsigned short    >::value
+	|| std::is_same<typename std::decay<V>::type, unsigned int      >::value
+	|| std::is_same<typename std::decay<V>::type, unsigned long     >::value
+	|| std::is_same<typename std::decay<V>::type, unsigned long long>::value>;
+
 /**
  * check type
  * Used to check if it is an STL coantainer.
@@ -117,19 +519,12 @@ template<typename T> using c_vec_iter   = const typename T::iterator;
 template<typename T>
 inline bool check_type(const WCHAR* text)
 {
-	if (   !std::is_same<std::decay<typename T::value_type>::type, char	             >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, short	             >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, int		         >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, long		         >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, long long         >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, unsigned char     >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, unsigned short    >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, unsigned int      >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, unsigned long     >::value
-		&& !std::is_same<std::decay<typename T::value_type>::type, unsigned long long>::value)
+	if (!radix_integral<typename T::value_type>::value)
 	{
 #if defined (_WIN64) || defined (WIN32)
 		MessageBox(NULL, text, L"Error", MB_ICONERROR);
+#else
+		(void)text;
 #endif // only for Windows
 		return false;
 	}
@@ -144,11 +539,11 @@ inline bool check_type(const WCHAR* text)
 template<typename T>
 inline bool isUnsigned()
 {
-	if (   std::is_same<std::decay<typename T::value_type>::type, unsigned char     >::value
-		|| std::is_same<std::decay<typename T::value_type>::type, unsigned short    >::value
-		|| std::is_same<std::decay<typename T::value_type>::type, unsigned int      >::value
-		|| std::is_same<std::decay<typename T::value_type>::type, unsigned long     >::value
-		|| std::is_same<std::decay<typename T::value_type>::type, unsigned long long>::value)
+	if (   std::is_same<typename std::decay<typename T::value_type>::type, unsigned char     >::value
+		|| std::is_same<typename std::decay<typename T::value_type>::type, unsigned short    >::value
+		|| std::is_same<typename std::decay<typename T::value_type>::type, unsigned int      >::value
+		|| std::is_same<typename std::decay<typename T::value_type>::type, unsigned long     >::value
+		|| std::is_same<typename std::decay<typename T::value_type>::type, unsigned long long>::value)
 		return true;
 	else return false;
 }
@@ -158,37 +553,106 @@ inline bool isUnsigned()
  * Used to swap two numbers more efficiently than in STL.
  * return void
  */
-template<typename T>
-inline void my_swap(T& i, T& j)
+template<typename Stats = Sort_Stats_Null, typename T>
+TVJ_CONSTEXPR20 inline void my_swap(T& i, T& j)
 {
+	Stats::swap();
 	auto temp = j;
 	j = i;
 	i = temp;
 }
 
+/**
+ * is segmented
+ * Whether the container keeps its elements in small blocks (std::deque),
+ * where every [] and iterator step has to look up the block map.
+ */
+template<typename T> struct is_segmented : std::false_type {};
+template<typename V, typename A> struct is_segmented<std::deque<V, A>> : std::true_type {};
+
+// the contiguous copy of a segmented container
+template<typename T> using staged_vector = std::vector<typename T::value_type>;
+
+/**
+ * staged sort
+ * Move the elements of a segmented container into a vector
+ * block by block, sort the vector with sort, and move them back.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null, typename Sort>
+void staged_sort(T& vec, Sort sort)
+{
+	staged_vector<T> staged(std::make_move_iterator(vec.begin()), std::make_move_iterator(vec.end()));
+	Stats::allocate(staged.size() * sizeof(typename T::value_type));
+	Stats::move(staged.size());
+	sort(staged);
+	std::move(staged.begin(), staged.end(), vec.begin());
+	Stats::move(staged.size());
+}
+
 /**
  * my_pow
  * Used to have the power of int.
- * return int
+ * return unsigned long long
  */
-int my_pow(int n, int m)
+inline unsigned long long my_pow(unsigned long long n, int m)
 {
-	int ret = 1;
+	unsigned long long ret = 1;
 	for (int i = 0; i != m; i++)
 		ret *= n;
 	return ret;
 }
 
+/**
+ * unsigned of
+ * Used to view an integer as its unsigned counterpart,
+ * so that shifting and dividing never see a negative number.
+ * return the unsigned integer
+ */
+template<typename V>
+inline typename std::make_unsigned<V>::type unsigned_of(V c)
+{
+	return static_cast<typename std::make_unsigned<V>::type>(c);
+}
+
+/**
+ * radix passes
+ * Used to count the digits of range in base (1 << bits).
+ * return int
+ */
+template<typename U>
+inline int radix_passes(U range, int bits = radix_binary)
+{
+	int passes = 0;
+	for (unsigned long long r = range; r; r >>= bits)
+		passes++;
+	return passes;
+}
+
+/**
+ * decimal digits
+ * Used to count the decimal digits of range (at least one).
+ * return int
+ */
+template<typename U>
+inline int decimal_digits(U range)
+{
+	int digits = 1;
+	for (unsigned long long r = range; r >= 10; r /= 10)
+		digits++;
+	return digits;
+}
+
 /**
  * medium (iterator)
  * return the medium one of the three,
  * used for iterators
  */
-template<typename T>
-inline auto medium(c_vec_iter<T>& a, c_vec_iter<T>& b, c_vec_iter<T>& c)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 inline auto medium(c_vec_iter<T>& a, c_vec_iter<T>& b, c_vec_iter<T>& c)
 {
-	if ((*a <= *b && *a >= *c) || (*a >= *b && *a <= *c)) return a;
-	else if ((*b <= *a && *b >= *c) || (*b >= *a && *b <= *c)) return b;
+	if ((Stats::less_equal(*a, *b) && Stats::greater_equal(*a, *c)) || (Stats::greater_equal(*a, *b) && Stats::less_equal(*a, *c))) return a;
+	else if ((Stats::less_equal(*b, *a) && Stats::greater_equal(*b, *c)) || (Stats::greater_equal(*b, *a) && Stats::less_equal(*b, *c))) return b;
 	else return c;
 }
 
@@ -197,11 +661,11 @@ inline auto medium(c_vec_iter<T>& a, c_vec_iter<T>& b, c_vec_iter<T>& c)
  * return the medium one of the three,
  * used for pointers
  */
-template<typename T>
-inline auto medium(T* a,T* b, T* c)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 inline auto medium(T* a,T* b, T* c)
 {
-	if ((*a <= *b && *a >= *c) || (*a >= *b && *a <= *c)) return a;
-	else if ((*b <= *a && *b >= *c) || (*b >= *a && *b <= *c)) return b;
+	if ((Stats::less_equal(*a, *b) && Stats::greater_equal(*a, *c)) || (Stats::greater_equal(*a, *b) && Stats::less_equal(*a, *c))) return a;
+	else if ((Stats::less_equal(*b, *a) && Stats::greater_equal(*b, *c)) || (Stats::greater_equal(*b, *a) && Stats::less_equal(*b, *c))) return b;
 	else return c;
 }
 
@@ -209,7 +673,7 @@ inline auto medium(T* a,T* b, T* c)
  * bubble sort (iterator)
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void bubble_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
 {
 	auto up = i_beg, k = i_beg;
@@ -218,9 +682,9 @@ void bubble_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
 		k = i_end;
 		for (auto i = i_end - 1; i > up; i--)
 		{
-			if (*i < *(i - 1))
+			if (Stats::less(*i, *(i - 1)))
 			{
-				my_swap(*i, *(i - 1));
+				my_swap<Stats>(*i, *(i - 1));
 				k = i;
 			}
 		}
@@ -232,7 +696,7 @@ void bubble_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
  * bubble sort (pointer)
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void bubble_sort(T* i_beg, T* i_end)
 {
 	auto up = i_beg, k = i_beg;
@@ -241,9 +705,9 @@ void bubble_sort(T* i_beg, T* i_end)
 		k = i_end;
 		for (auto i = i_end - 1; i > up; i--)
 		{
-			if (*i < *(i - 1))
+			if (Stats::less(*i, *(i - 1)))
 			{
-				my_swap(*i, *(i - 1));
+				my_swap<Stats>(*i, *(i - 1));
 				k = i;
 			}
 		}
@@ -255,19 +719,23 @@ void bubble_sort(T* i_beg, T* i_end)
  * insertion sort (iterator)
  * return void
  */
-template<typename T>
-void insertion_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void insertion_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
 {
+	if (i_beg == i_end) return;
 	for (auto i = i_beg + 1; i != i_end; i++)
 	{
-		auto temp = *i;
+		auto temp = std::move(*i);
 		// slide elements right to make room for v[i]
 		auto j = i;
-		while (j >= i_beg + 1 && *(j - 1) > temp)
+		while (j >= i_beg + 1 && Stats::greater(*(j - 1), temp))
 		{
-			*(j--) = *(j - 1);
+			*j = std::move(*(j - 1));
+			Stats::move();
+			j--;
 		}
-		*j = temp;
+		*j = std::move(temp);
+		Stats::move();
 	}
 }
 
@@ -275,19 +743,23 @@ void insertion_sort(vec_iter<T> i_beg, vec_iter<T> i_end)
  * insertion sort (pointer)
  * return void
  */
-template<typename T>
-void insertion_sort(T* i_beg, T* i_end)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void insertion_sort(T* i_beg, T* i_end)
 {
+	if (i_beg == i_end) return;
 	for (auto i = i_beg + 1; i != i_end; i++)
 	{
-		auto temp = *i;
+		auto temp = std::move(*i);
 		// slide elements right to make room for v[i]
 		auto j = i;
-		while (j >= i_beg + 1 && *(j - 1) > temp)
+		while (j >= i_beg + 1 && Stats::greater(*(j - 1), temp))
 		{
-			*(j--) = *(j - 1);
+			*j = std::move(*(j - 1));
+			Stats::move();
+			j--;
 		}
-		*j = temp;
+		*j = std::move(temp);
+		Stats::move();
 	}
 }
 
@@ -298,9 +770,10 @@ void insertion_sort(T* i_beg, T* i_end)
  * Argument 3: the end iterator
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void quick_sort(T& vec, vec_iter<T> i, vec_iter<T> j)
 {
+	typename Stats::Depth depth; // count the recursion depth
 	if (j - i <= 1) return;
 	else
 	{
@@ -310,17 +783,17 @@ void quick_sort(T& vec, vec_iter<T> i, vec_iter<T> j)
 
 		while (i != j)
 		{
-			do { --j; } while (*j > standard_number && i < j);
+			do { --j; } while (Stats::greater(*j, standard_number) && i < j);
 			if (i == j) break;
 			else
 			{
-				do { ++i; } while (*i < standard_number && i < j);
-				my_swap(*i, *j);
+				do { ++i; } while (Stats::less(*i, standard_number) && i < j);
+				my_swap<Stats>(*i, *j);
 			}
 		}
-		my_swap(*init_begin, *i);
-		quick_sort(vec, init_begin, i);
-		quick_sort(vec, i + 1, init_end);
+		my_swap<Stats>(*init_begin, *i);
+		quick_sort<T, Stats>(vec, init_begin, i);
+		quick_sort<T, Stats>(vec, i + 1, init_end);
 	}
 }
 
@@ -330,15 +803,16 @@ void quick_sort(T& vec, vec_iter<T> i, vec_iter<T> j)
  * Argument 2: the end iterator
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void quick_sort_pro(vec_iter<T> i, vec_iter<T> j)
 {
+	typename Stats::Depth depth; // count the recursion depth
 	if (j - i <= 1) return;
 	else if (j - i == 2)
 	{
-		if (*i > * (j - 1))
+		if (Stats::greater(*i, *(j - 1)))
 		{
-			my_swap(*i, *(j - 1));
+			my_swap<Stats>(*i, *(j - 1));
 		}
 		return;
 	}
@@ -346,7 +820,7 @@ void quick_sort_pro(vec_iter<T> i, vec_iter<T> j)
 	{
 		// If the number is not large,
 		// insertion sort can be more efficient.
-		insertion_sort<T>(i, j);
+		insertion_sort<T, Stats>(i, j);
 		return;
 	}
 	else
@@ -357,17 +831,17 @@ void quick_sort_pro(vec_iter<T> i, vec_iter<T> j)
 		auto Standard_defined = *init_begin;
 		while (i != j)
 		{
-			do { --j; } while (*j > Standard_defined && i < j);
+			do { --j; } while (Stats::greater(*j, Standard_defined) && i < j);
 			if (i == j) break;
 			else
 			{
-				do { ++i; } while (*i < Standard_defined && i < j);
-				my_swap(*i, *j);
+				do { ++i; } while (Stats::less(*i, Standard_defined) && i < j);
+				my_swap<Stats>(*i, *j);
 			}
 		}
-		my_swap(*init_begin, *i);
-		quick_sort_pro<T>(init_begin, i);
-		quick_sort_pro<T>(i + 1, init_end);
+		my_swap<Stats>(*init_begin, *i);
+		quick_sort_pro<T, Stats>(init_begin, i);
+		quick_sort_pro<T, Stats>(i + 1, init_end);
 	}
 }
 
@@ -377,15 +851,16 @@ void quick_sort_pro(vec_iter<T> i, vec_iter<T> j)
  * Argument 2: the end iterator
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void quick_sort_pro(T* i, T* j)
 {
+	typename Stats::Depth depth; // count the recursion depth
 	if (j - i <= 1) return;
 	else if (j - i == 2)
 	{
-		if (*i > * (j - 1))
+		if (Stats::greater(*i, *(j - 1)))
 		{
-			my_swap(*i, *(j - 1));
+			my_swap<Stats>(*i, *(j - 1));
 		}
 		return;
 	}
@@ -393,7 +868,7 @@ void quick_sort_pro(T* i, T* j)
 	{
 		// If the number is not large,
 		// insertion sort can be more efficient.
-		insertion_sort<T>(i, j);
+		insertion_sort<T, Stats>(i, j);
 		return;
 	}
 	else
@@ -404,18 +879,62 @@ void quick_sort_pro(T* i, T* j)
 		auto Standard_defined = *init_begin;
 		while (i != j)
 		{
-			do { --j; } while (*j > Standard_defined && i < j);
+			do { --j; } while (Stats::greater(*j, Standard_defined) && i < j);
 			if (i == j) break;
 			else
 			{
-				do { ++i; } while (*i < Standard_defined && i < j);
-				my_swap(*i, *j);
+				do { ++i; } while (Stats::less(*i, Standard_defined) && i < j);
+				my_swap<Stats>(*i, *j);
 			}
 		}
-		my_swap(*init_begin, *i);
-		quick_sort_pro<T>(init_begin, i);
-		quick_sort_pro<T>(i + 1, init_end);
+		my_swap<Stats>(*init_begin, *i);
+		quick_sort_pro<T, Stats>(init_begin, i);
+		quick_sort_pro<T, Stats>(i + 1, init_end);
+	}
+}
+
+/**
+ * quick partition (around a given pivot)
+ * Partition [i, j) around the element at standard_number, which must be in [i, j):
+ * the pivot ends at its sorted place, with no larger element before it
+ * and no smaller one after it.
+ * return the iterator to the pivot
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 vec_iter<T> quick_partition(vec_iter<T> i, vec_iter<T> j, vec_iter<T> standard_number)
+{
+	auto init_begin = i;
+
+	auto Standard_defined = *standard_number;
+	my_swap<Stats>(*standard_number, *init_begin);
+	while (i != j)
+	{
+		do { --j; } while (Stats::greater(*j, Standard_defined) && i < j);
+		if (i == j) break;
+		else
+		{
+			do { ++i; } while (Stats::less(*i, Standard_defined) && i < j);
+			my_swap<Stats>(*i, *j);
+		}
 	}
+	my_swap<Stats>(*init_begin, *i);
+	return i;
+}
+
+/**
+ * quick partition
+ * Partition [i, j) (at least three elements) as quick_sort_pro_safe does,
+ * around the medium one of the first, the middle and the last element.
+ * return the iterator to the pivot
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 vec_iter<T> quick_partition(vec_iter<T> i, vec_iter<T> j)
+{
+	// Choose the medium one of the three numbers,
+	// in order to avoid the circumstance that
+	// the standard number is too large or too small
+	// when quicksort can be reduced from o(nlog(n)) to o(N^2).
+	return quick_partition<T, Stats>(i, j, medium<T, Stats>(i, j - 1, i + ((j - i) - 1) / 2));
 }
 
 /**
@@ -426,49 +945,31 @@ void quick_sort_pro(T* i, T* j)
  * Do not support 'list'.
  * return void
  */
-template<typename T>
-void quick_sort_pro_safe(vec_iter<T> i, vec_iter<T> j)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void quick_sort_pro_safe(vec_iter<T> i, vec_iter<T> j)
 {
+	typename Stats::Depth depth; // count the recursion depth
 	if (j - i <= 1) return;
+	else if (j - i >= sort_checkpoint && Stats::stop()) return;
 	else if (j - i == 2)
 	{
-		if (*i > * (j - 1))
+		if (Stats::greater(*i, *(j - 1)))
 		{
-			my_swap(*i, *(j - 1));
+			my_swap<Stats>(*i, *(j - 1));
 		}
 	}
 	else if (j - i <= 7)
 	{
 		// If the number is not large,
 		// insertion sort can be more efficient.
-		insertion_sort<T>(i, j);
+		insertion_sort<T, Stats>(i, j);
 		return;
 	}
 	else
 	{
-		// Choose the medium one of the three numbers,
-		// in order to avoid the circumstance that
-		// the standard number is too large or too small
-		// when quicksort can be reduced from o(nlog(n)) to o(N^2).
-		auto standard_number = medium<T>(i, j - 1, i + ((j - i) - 1) / 2);
-		auto init_begin = i;
-		auto init_end = j;
-
-		auto Standard_defined = *standard_number;
-		my_swap(*standard_number, *init_begin);
-		while (i != j)
-		{
-			do { --j; } while (*j > Standard_defined && i < j);
-			if (i == j) break;
-			else
-			{
-				do { ++i; } while (*i < Standard_defined && i < j);
-				my_swap(*i, *j);
-			}
-		}
-		my_swap(*init_begin, *i);
-		quick_sort_pro_safe<T>(init_begin, i);
-		quick_sort_pro_safe<T>(i + 1, init_end);
+		auto standard = quick_partition<T, Stats>(i, j);
+		quick_sort_pro_safe<T, Stats>(i, standard);
+		quick_sort_pro_safe<T, Stats>(standard + 1, j);
 	}
 }
 
@@ -479,22 +980,24 @@ void quick_sort_pro_safe(vec_iter<T> i, vec_iter<T> j)
  * Argument 2: the end iterator
  * return void
  */
-template<typename T>
-void quick_sort_pro_safe(T* i, T* j)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void quick_sort_pro_safe(T* i, T* j)
 {
+	typename Stats::Depth depth; // count the recursion depth
 	if (j - i <= 1) return;
+	else if (j - i >= sort_checkpoint && Stats::stop()) return;
 	else if (j - i == 2)
 	{
-		if (*i > * (j - 1))
+		if (Stats::greater(*i, *(j - 1)))
 		{
-			my_swap(*i, *(j - 1));
+			my_swap<Stats>(*i, *(j - 1));
 		}
 	}
 	else if (j - i <= 7)
 	{
 		// If the number is not large,
 		// insertion sort can be more efficient.
-		insertion_sort<T>(i, j);
+		insertion_sort<T, Stats>(i, j);
 		return;
 	}
 	else
@@ -503,26 +1006,123 @@ void quick_sort_pro_safe(T* i, T* j)
 		// in order to avoid the circumstance that
 		// the standard number is too large or too small
 		// when quicksort can be reduced from o(nlog(n)) to o(N^2).
-		auto standard_number = medium<T>(i, j - 1, i + ((j - i) - 1) / 2);
+		auto standard_number = medium<T, Stats>(i, j - 1, i + ((j - i) - 1) / 2);
 		auto init_begin = i;
 		auto init_end = j;
 
 		auto Standard_defined = *standard_number;
-		my_swap(*standard_number, *init_begin);
+		my_swap<Stats>(*standard_number, *init_begin);
 		while (i != j)
 		{
-			do { --j; } while (*j > Standard_defined && i < j);
+			do { --j; } while (Stats::greater(*j, Standard_defined) && i < j);
 			if (i == j) break;
 			else
 			{
-				do { ++i; } while (*i < Standard_defined && i < j);
-				my_swap(*i, *j);
+				do { ++i; } while (Stats::less(*i, Standard_defined) && i < j);
+				my_swap<Stats>(*i, *j);
 			}
 		}
-		my_swap(*init_begin, *i);
-		quick_sort_pro_safe<T>(init_begin, i);
-		quick_sort_pro_safe<T>(i + 1, init_end);
+		my_swap<Stats>(*init_begin, *i);
+		quick_sort_pro_safe<T, Stats>(init_begin, i);
+		quick_sort_pro_safe<T, Stats>(i + 1, init_end);
+	}
+}
+
+/**
+ * radix buckets
+ * Tell Stats about the largest bucket of one distribution.
+ * before_number holds the first index of every bucket.
+ * return void
+ */
+template<typename Stats>
+inline void radix_buckets(const size_t* before_number, size_t buckets, size_t total)
+{
+	if (!Stats::enabled) return;
+	size_t largest = 0;
+	for (size_t i = 0; i != buckets; i++)
+	{
+		size_t bucket_size = (i + 1 == buckets ? total : before_number[i + 1]) - before_number[i];
+		largest = my_max(largest, bucket_size);
+	}
+	Stats::buckets(largest, total, buckets);
+}
+
+/**
+ * Radix_Lines
+ * The software write-combining buffers of a radix scatter
+ * (used by the heap radix sorts when TVJ_SORT_WRITE_COMBINE is defined).
+ * Every bucket stages one cache line of elements
+ * and a full line is written to its bucket at once,
+ * so the scatter writes whole lines instead of one element to each of 256 places.
+ * With 256 buckets the plain scatter mostly stays in the L1 cache already,
+ * so this is off by default; it helps where stores to many pages are expensive.
+ */
+template<typename V>
+struct Radix_Lines
+{
+	static const size_t line = 64 / sizeof(V) ? 64 / sizeof(V) : 1;
+	alignas(64) V staged[radix_index][line];
+	unsigned char fill[radix_index]{ 0 };
+	// stage c in bucket b, return true if the line of b is full
+	inline bool put(size_t b, const V& c)
+	{
+		unsigned char f = fill[b];
+		staged[b][f] = c;
+		fill[b] = ++f == line ? 0 : f;
+		return f == line;
+	}
+};
+
+/**
+ * radix store
+ * Write count staged elements to their bucket.
+ * With TVJ_SORT_STREAMING_STORES defined on x86-64, elements of 4 or 8 bytes
+ * bypass the cache (non-temporal stores), which only pays off for arrays
+ * much larger than the last level cache. Call radix_store_fence after the scatter.
+ * return void
+ */
+template<typename V>
+inline void radix_store(V* to, const V* from, size_t count)
+{
+#if defined (TVJ_SORT_STREAMING_STORES) && (defined (__x86_64__) || defined (_M_X64))
+	if (std::is_integral<V>::value && sizeof(V) == 8)
+	{
+		for (size_t i = 0; i != count; i++)
+		{
+			long long value;
+			std::memcpy(&value, from + i, 8);
+#if defined (_M_X64) && !defined (__clang__)
+			_mm_stream_si64x(reinterpret_cast<long long*>(to + i), value);
+#else
+			_mm_stream_si64(reinterpret_cast<long long*>(to + i), value);
+#endif
+		}
+		return;
+	}
+	if (std::is_integral<V>::value && sizeof(V) == 4)
+	{
+		for (size_t i = 0; i != count; i++)
+		{
+			int value;
+			std::memcpy(&value, from + i, 4);
+			_mm_stream_si32(reinterpret_cast<int*>(to + i), value);
+		}
+		return;
 	}
+#endif // TVJ_SORT_STREAMING_STORES
+	std::copy(from, from + count, to);
+}
+
+/**
+ * radix store fence
+ * Order the non-temporal stores of radix_store before the following loads.
+ * return void
+ */
+inline void radix_store_fence()
+{
+#if defined (TVJ_SORT_STREAMING_STORES) && (defined (__x86_64__) || defined (_M_X64))
+	_mm_sfence();
+#endif // TVJ_SORT_STREAMING_STORES
 }
 
 /**
@@ -532,27 +1132,41 @@ void quick_sort_pro_safe(T* i, T* j)
  * Do not support 'list' and 'array'.
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_one(T& vec, int n)
 {
 	if (!check_type<T>(L"counting_sort_one can not be applied to non-integer value types.")) return;
-	T bucket[10];
+	staged_vector<T> bucket[10];
 	size_t before_number[10]{ 0 };
+	Stats::allocate(vec.size() * sizeof(typename T::value_type));
+	TVJ_SORT_STEP_FIRST("scatter");
 	for (const auto& c : vec)
 	{
-		bucket[c / my_pow(10, n) % 10].push_back(c);
+		bucket[unsigned_of(c) / my_pow(10, n) % 10].push_back(c);
 	}
+	Stats::move(vec.size());
+	TVJ_SORT_STEP("histogram");
 	for (size_t i = 1; i != 10; i++)
 	{
 		before_number[i] = before_number[i - 1] + bucket[i - 1].size();
 	}
-	for (size_t i = 0; i != 10; i++)
+	radix_buckets<Stats>(before_number, 10, vec.size());
+	TVJ_SORT_STEP("copy-back");
+	// If all the elements are in one bucket, nothing has moved.
+	bool taken = bucket[unsigned_of(vec[0]) / my_pow(10, n) % 10].size() != vec.size();
+	Stats::pass(taken);
+	if (taken)
 	{
-		for (size_t j = 0; j != bucket[i].size(); j++)
+		// write sequentially (a std::deque looks up its block map for every [])
+		auto out = vec.begin();
+		for (size_t i = 0; i != 10; i++)
 		{
-			// store the numbers by sequence
-			vec[before_number[i] + j] = bucket[i][j];
+			for (size_t j = 0; j != bucket[i].size(); j++)
+			{
+				*out++ = bucket[i][j]; // store the numbers by sequence
+			}
 		}
+		Stats::move(vec.size());
 	}
 }
 
@@ -563,27 +1177,63 @@ void counting_sort_one(T& vec, int n)
  * Do not support 'list' and 'array'.
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_one_pro(T& vec, size_t n)
 {
 	if (!check_type<T>(L"counting_sort_one_pro can not be applied to non-integer value types.")) return;
-	T bucket[radix_index];
+	staged_vector<T> bucket[radix_index];
 	size_t before_number[radix_index]{ 0 };
+	Stats::allocate(vec.size() * sizeof(typename T::value_type));
+	TVJ_SORT_STEP_FIRST("scatter");
 	for (const auto& c : vec)
 	{
-		bucket[c >> (n * radix_binary) & (radix_index - 1)].push_back(c);
+		bucket[unsigned_of(c) >> (n * radix_binary) & (radix_index - 1)].push_back(c);
 	}
+	Stats::move(vec.size());
+	TVJ_SORT_STEP("histogram");
 	for (size_t i = 1; i != radix_index; i++)
 	{
 		before_number[i] = before_number[i - 1] + bucket[i - 1].size();
 	}
-	for (size_t i = 0; i != radix_index; i++)
+	radix_buckets<Stats>(before_number, radix_index, vec.size());
+	TVJ_SORT_STEP("copy-back");
+	// If all the elements are in one bucket, nothing has moved.
+	bool taken = bucket[unsigned_of(vec[0]) >> (n * radix_binary) & (radix_index - 1)].size() != vec.size();
+	Stats::pass(taken);
+	if (taken)
 	{
-		for (size_t j = 0; j != bucket[i].size(); j++)
+		auto out = vec.begin();
+		for (size_t i = 0; i != radix_index; i++)
+		{
+			for (size_t j = 0; j != bucket[i].size(); j++)
+			{
+				*out++ = bucket[i][j]; // store the numbers by sequence
+			}
+		}
+		Stats::move(vec.size());
+	}
+}
+
+/**
+ * radix insertion sort
+ * Insertion sort of vec[i_beg, i_end) in the unsigned view,
+ * for the radix sorts whose numbers have been offset by the minimum
+ * (they may wrap below zero in the signed type).
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void radix_insertion_sort(T& vec, size_t i_beg, size_t i_end)
+{
+	for (size_t i = i_beg + 1; i < i_end; i++)
+	{
+		auto c = vec[i];
+		size_t j = i;
+		for (; j != i_beg && Stats::less(unsigned_of(c), unsigned_of(vec[j - 1])); j--)
 		{
-			// store the numbers by sequence
-			vec[before_number[i] + j] = bucket[i][j];
+			vec[j] = vec[j - 1];
 		}
+		vec[j] = c;
+		Stats::move(i - j);
 	}
 }
 
@@ -594,38 +1244,65 @@ void counting_sort_one_pro(T& vec, size_t n)
  * Do not support 'list'.
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_one_pro_heap1(T& vec, size_t n)
 {
 	if (!check_type<T>(L"counting_sort_one_pro_heap1 can not be applied to non-integer value types.")) return;
 	if (vec.size() < 7)
 	{
 		// If the number is not large,
-		// insertion sort can be more efficient.
-		insertion_sort<T>(vec.begin(), vec.end());
+		// insertion sort can be more efficient
+		// (in the unsigned view, as the numbers have been offset).
+		radix_insertion_sort<T, Stats>(vec, 0, vec.size());
 	}
 	else
 	{
-		Heap_Vector<typename T::value_type> bucket[radix_index];
+		Heap_Vector<typename T::value_type, Stats> bucket[radix_index];
 		size_t before_number[radix_index]{ 0 };
+		TVJ_SORT_STEP_FIRST("scatter");
+#ifdef TVJ_SORT_WRITE_COMBINE
+		Radix_Lines<typename T::value_type> lines; // one line per bucket, on the stack
+		for (const auto& c : vec)
+		{
+			size_t b = unsigned_of(c) >> (n * radix_binary) & (radix_index - 1);
+			if (lines.put(b, c))
+			{
+				bucket[b].append(lines.staged[b], lines.line);
+			}
+		}
+		for (size_t i = 0; i != radix_index; i++)
+			bucket[i].append(lines.staged[i], lines.fill[i]);
+#else
 		for (const auto& c : vec)
 		{
 			// equivalent to:
 			// bucket[c / my_pow(radix_index, n) % radix_index].push_back(c);
 			// but using the operator >> and & can be more efficient
-			bucket[c >> (n * radix_binary) & (radix_index - 1)].push_back(c);
+			bucket[unsigned_of(c) >> (n * radix_binary) & (radix_index - 1)].push_back(c);
 		}
+#endif // TVJ_SORT_WRITE_COMBINE
+		Stats::move(vec.size());
+		TVJ_SORT_STEP("histogram");
 		for (size_t i = 1; i != radix_index; i++)
 		{
 			before_number[i] = before_number[i - 1] + bucket[i - 1].size();
 		}
-		for (size_t i = 0; i != radix_index; i++)
+		radix_buckets<Stats>(before_number, radix_index, vec.size());
+		TVJ_SORT_STEP("copy-back");
+		// If all the elements are in one bucket, nothing has moved.
+		bool taken = bucket[unsigned_of(vec[0]) >> (n * radix_binary) & (radix_index - 1)].size() != vec.size();
+		Stats::pass(taken);
+		if (taken)
 		{
-			for (size_t j = 0; j != bucket[i].size(); j++)
+			auto out = vec.begin();
+			for (size_t i = 0; i != radix_index; i++)
 			{
-				// store the numbers by sequence
-				vec[before_number[i] + j] = bucket[i][j];
+				for (size_t j = 0; j != bucket[i].size(); j++)
+				{
+					*out++ = bucket[i][j]; // store the numbers by sequence
+				}
 			}
+			Stats::move(vec.size());
 		}
 	}
 }
@@ -633,66 +1310,289 @@ void counting_sort_one_pro_heap1(T& vec, size_t n)
 /**
  * counting sort one pro heap2
  * One way to sort one digit of an integer in the binary form using dynamic array.
+ * The digits are counted first, so one array of vec.size() elements holds all the buckets.
  * Must support [].
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_one_pro_heap2(T& vec, int n)
 {
 	if (!check_type<T>(L"counting_sort_ont_pro_heap2 can not be applied to non-integer value types.")) return;
-	typename T::value_type** bucket = new typename T::value_type* [radix_index]; // define a dynamic array of arrays
-	for (size_t i = 0; i != radix_index; i++)
-		bucket[i] = new int[vec.size()];     // define a dynamic array
+	TVJ_SORT_STEP_FIRST("histogram");
 	size_t element_number[radix_index]{ 0 }; // initialize to 0
 	size_t before_number[radix_index]{ 0 };  // initialize to 0
 	for (const auto& c : vec)
 	{
-		// equivalent to:
-		// int bucket_number = c / my_pow(radix_index, n) % radix_index;
-		// but using the operator >> and & can be more efficient
-		auto bucket_number = c >> (n * radix_binary) & (radix_index - 1);
-		// increment the element_number at the same time
-		bucket[bucket_number][element_number[bucket_number]++] = c;
+		element_number[unsigned_of(c) >> (n * radix_binary) & (radix_index - 1)]++;
 	}
 	for (size_t i = 1; i != radix_index; i++)
 	{
 		before_number[i] = before_number[i - 1] + element_number[i - 1];
 	}
+	radix_buckets<Stats>(before_number, radix_index, vec.size());
+	// If all the elements are in one bucket, nothing has to move.
+	bool taken = element_number[unsigned_of(vec[0]) >> (n * radix_binary) & (radix_index - 1)] != vec.size();
+	Stats::pass(taken);
+	if (!taken) return;
+	TVJ_SORT_STEP("allocate");
+	typename T::value_type* buffer = new typename T::value_type[vec.size()]; // define a dynamic array
+	Stats::allocate(vec.size() * sizeof(typename T::value_type));
+	typename T::value_type* bucket[radix_index]; // the next place of every bucket in the array
 	for (size_t i = 0; i != radix_index; i++)
+		bucket[i] = buffer + before_number[i];
+	TVJ_SORT_STEP("scatter");
+#ifdef TVJ_SORT_WRITE_COMBINE
+	Radix_Lines<typename T::value_type> lines; // one line per bucket, on the stack
+	for (const auto& c : vec)
 	{
-		for (size_t j = 0; j != element_number[i]; j++)
+		size_t bucket_number = unsigned_of(c) >> (n * radix_binary) & (radix_index - 1);
+		// write the line when it is full
+		if (lines.put(bucket_number, c))
 		{
-			// store the numbers by sequence
-			vec[before_number[i] + j] = bucket[i][j];
+			radix_store(bucket[bucket_number], lines.staged[bucket_number], lines.line);
+			bucket[bucket_number] += lines.line;
 		}
 	}
 	for (size_t i = 0; i != radix_index; i++)
-		delete[] bucket[i]; // free the dynamic arrays
-}
-
-/**
- * counting sort multi
- * Sort multi digits of an integer.
- * Must support [].
- * Do not support 'list' and 'array'.
+		radix_store(bucket[i], lines.staged[i], lines.fill[i]);
+	radix_store_fence();
+#else
+	for (const auto& c : vec)
+	{
+		// equivalent to:
+		// int bucket_number = c / my_pow(radix_index, n) % radix_index;
+		// but using the operator >> and & can be more efficient
+		auto bucket_number = unsigned_of(c) >> (n * radix_binary) & (radix_index - 1);
+		// move the place of the bucket at the same time
+		*bucket[bucket_number]++ = c;
+	}
+#endif // TVJ_SORT_WRITE_COMBINE
+	Stats::move(vec.size());
+	TVJ_SORT_STEP("copy-back");
+	auto out = vec.begin();
+	for (size_t i = 0; i != vec.size(); i++)
+	{
+		*out++ = buffer[i]; // the buckets are already in sequence
+	}
+	Stats::move(vec.size());
+	TVJ_SORT_STEP("free");
+	delete[] buffer; // free the dynamic array
+}
+
+/**
+ * radix sort in place
+ * MSD radix sort of [i_beg, i_end) from digit n down (American flag sort).
+ * Every bucket is counted first and the elements are swapped along the cycles
+ * into their buckets, so nothing is allocated.
+ * The elements must be no less than zero (in the unsigned view).
+ * Must support [].
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
+void radix_sort_in_place(T& vec, size_t i_beg, size_t i_end, int n)
+{
+	typename Stats::Depth depth; // count the recursion depth
+	if (i_end - i_beg >= sort_checkpoint && Stats::stop()) return;
+	if (i_end - i_beg < 32)
+	{
+		// If the number is not large,
+		// insertion sort can be more efficient
+		// (in the unsigned view, as the numbers have been offset).
+		radix_insertion_sort<T, Stats>(vec, i_beg, i_end);
+		return;
+	}
+	size_t element_number[radix_index]{ 0 };
+	size_t before_number[radix_index]{ 0 };
+	for (size_t i = i_beg; i != i_end; i++)
+	{
+		element_number[unsigned_of(vec[i]) >> (n * radix_binary) & (radix_index - 1)]++;
+	}
+	for (size_t i = 1; i != radix_index; i++)
+	{
+		before_number[i] = before_number[i - 1] + element_number[i - 1];
+	}
+	radix_buckets<Stats>(before_number, radix_index, i_end - i_beg);
+	bool taken = element_number[unsigned_of(vec[i_beg]) >> (n * radix_binary) & (radix_index - 1)] != i_end - i_beg;
+	Stats::pass(taken);
+	if (taken)
+	{
+		size_t head[radix_index]; // the first place of every bucket not yet filled
+		for (size_t i = 0; i != radix_index; i++)
+			head[i] = i_beg + before_number[i];
+		for (size_t i = 0; i != radix_index; i++)
+		{
+			size_t tail = i_beg + before_number[i] + element_number[i];
+			while (head[i] != tail)
+			{
+				// carry the element along its cycle until one belongs here
+				auto c = vec[head[i]];
+				size_t bucket_number;
+				while ((bucket_number = unsigned_of(c) >> (n * radix_binary) & (radix_index - 1)) != i)
+				{
+					my_swap<Stats>(c, vec[head[bucket_number]++]);
+				}
+				vec[head[i]++] = c;
+			}
+		}
+		Stats::move(i_end - i_beg);
+	}
+	if (n)
+	{
+		for (size_t i = 0; i != radix_index; i++)
+		{
+			// a bucket with less than two elements is already sorted
+			if (element_number[i] > 1)
+				radix_sort_in_place<T, Stats>(vec, i_beg + before_number[i], i_beg + before_number[i] + element_number[i], n - 1);
+		}
+	}
+}
+
+// the scratch memory of the radix sorts is not limited
+#define sort_budget_unlimited (~static_cast<size_t>(0))
+
+// the largest range (max - min) of keys sorted by counting_sort_direct
+#define counting_range 65536
+
+/**
+ * counting histogram
+ * Count every value c of vec in count[c - base] (values entries, already zero).
+ * Up to radix_index values are counted into four histograms in turn,
+ * so that runs of equal keys do not wait on each other.
+ * return void
+ */
+template<typename T, typename U>
+void counting_histogram(const T& vec, U base, size_t values, size_t* count)
+{
+	if (values <= radix_index)
+	{
+		size_t sub_count[3][radix_index];
+		for (auto& c : sub_count)
+			std::fill_n(c, values, 0);
+		auto it = vec.begin();
+		size_t i = 0, size = vec.size();
+		for (; i + 4 <= size; i += 4)
+		{
+			count[static_cast<U>(unsigned_of(*it++) - base)]++;
+			sub_count[0][static_cast<U>(unsigned_of(*it++) - base)]++;
+			sub_count[1][static_cast<U>(unsigned_of(*it++) - base)]++;
+			sub_count[2][static_cast<U>(unsigned_of(*it++) - base)]++;
+		}
+		for (; i != size; i++)
+			count[static_cast<U>(unsigned_of(*it++) - base)]++;
+		for (size_t k = 0; k != values; k++)
+			count[k] += sub_count[0][k] + sub_count[1][k] + sub_count[2][k];
+	}
+	else
+	{
+		for (const auto& c : vec)
+			count[static_cast<U>(unsigned_of(c) - base)]++;
+	}
+}
+
+/**
+ * counting sort direct
+ * Sort integers of a small range by counting every value and writing the values out again,
+ * with one histogram pass (counting_histogram) and one sequential fill pass.
+ * It is used when the range (max_one - min_one) is below counting_range and not much larger than vec.size(),
+ * and the histogram fits in budget (bytes). The values are counted from min_one on.
+ * Must support [].
+ * return true if vec is sorted here
+ */
+template<typename T, typename Stats = Sort_Stats_Null, typename V>
+bool counting_sort_direct(T& vec, V min_one, V max_one, size_t budget)
+{
+	typedef typename std::make_unsigned<V>::type U;
+	// max - min for the unsigned types as well
+	const U base = unsigned_of(min_one);
+	const U range = unsigned_of(max_one) - base;
+	if (range >= counting_range || range > 2 * vec.size() + radix_index) return false;
+	const size_t values = static_cast<size_t>(range) + 1;
+	size_t small_count[radix_index];
+	std::vector<size_t> large_count;
+	size_t* count = small_count;
+	if (values <= radix_index)
+	{
+		std::fill_n(small_count, values, 0);
+	}
+	else
+	{
+		if (values * sizeof(size_t) > budget) return false;
+		large_count.assign(values, 0);
+		Stats::allocate(values * sizeof(size_t));
+		count = large_count.data();
+	}
+	TVJ_SORT_STEP_FIRST("histogram");
+	counting_histogram(vec, base, values, count);
+	Stats::pass(true);
+	TVJ_SORT_STEP("fill");
+	auto out = vec.begin();
+	for (size_t k = 0; k != values; k++)
+	{
+		out = std::fill_n(out, count[k], static_cast<typename T::value_type>(static_cast<U>(base + k)));
+	}
+	Stats::move(vec.size());
+	return true;
+}
+
+/**
+ * radix budget passes
+ * Keep the scratch memory of a radix sort within budget (bytes).
+ * bytes is the most the sort itself may allocate for vec.
+ * If it is over budget, the passes are done here instead:
+ * by LSD passes through one array of vec.size() elements (LSD_sort_pro_heap2) if that fits,
+ * and in place (radix_sort_in_place) if not.
+ * The elements must be no less than zero (in the unsigned view).
+ * return true if vec is sorted here
+ */
+template<typename T, typename Stats = Sort_Stats_Null, typename U>
+bool radix_budget_passes(T& vec, U range, size_t budget, size_t bytes)
+{
+	if (bytes <= budget) return false;
+	if (!range) return true; // all the elements are equal
+	if (vec.size() * sizeof(typename T::value_type) <= budget)
+	{
+		for (int i = 0; i != radix_passes(range) && !Stats::stop(); i++)
+		{
+			counting_sort_one_pro_heap2<T, Stats>(vec, i);
+			Stats::progress(i + 1, radix_passes(range));
+		}
+	}
+	else
+	{
+		radix_sort_in_place<T, Stats>(vec, 0, vec.size(), radix_passes(range) - 1);
+	}
+	return true;
+}
+
+/**
+ * counting sort multi
+ * Sort multi digits of an integer.
+ * Must support [].
+ * Do not support 'list' and 'array'.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_multi(T& vec, size_t n)
 {
 	if (!check_type<T>(L"counting_sort_multi can not be applied to non-integer value types.")) return;
+	typename Stats::Depth depth; // count the recursion depth
+	if (vec.size() >= sort_checkpoint && Stats::stop()) return;
 	T bucket[10];
 	size_t before_number[10]{ 0 };
+	Stats::allocate(vec.size() * sizeof(typename T::value_type));
 	for (const auto& c : vec)
 	{
-		bucket[c / my_pow(10, n) % 10].push_back(c);
+		bucket[unsigned_of(c) / my_pow(10, n) % 10].push_back(c);
 	}
+	Stats::move(vec.size());
+	Stats::pass(true);
 
 	if (n)
 	{
 		for (auto& c : bucket)
 		{
-			counting_sort_multi<T>(c, n - 1);
+			// a bucket with less than two elements is already sorted
+			if (c.size() > 1) counting_sort_multi<T, Stats>(c, n - 1);
 		}
 	}
 
@@ -700,13 +1600,16 @@ void counting_sort_multi(T& vec, size_t n)
 	{
 		before_number[i] = before_number[i - 1] + bucket[i - 1].size();
 	}
+	radix_buckets<Stats>(before_number, 10, vec.size());
+	auto out = vec.begin();
 	for (size_t i = 0; i != 10; i++)
 	{
 		for (size_t j = 0; j != bucket[i].size(); j++)
 		{
-			vec[before_number[i] + j] = bucket[i][j]; // store the numbers by sequence
+			*out++ = bucket[i][j]; // store the numbers by sequence
 		}
 	}
+	Stats::move(vec.size());
 }
 
 /**
@@ -716,38 +1619,47 @@ void counting_sort_multi(T& vec, size_t n)
  * Do not support 'list' and 'array'.
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void counting_sort_multi_pro(T& vec, size_t n)
 {
 	if (!check_type<T>(L"LSD_sort_pro_heap1 can not be applied to non-integer value types.")) return;
+	typename Stats::Depth depth; // count the recursion depth
+	if (vec.size() >= sort_checkpoint && Stats::stop()) return;
 
 	T bucket[radix_index];
 	size_t before_number[radix_index]{ 0 };
+	Stats::allocate(vec.size() * sizeof(typename T::value_type));
 	for (auto c : vec)
 	{
 		// equivalent to:
 		// bucket[c / my_pow(radix_index, n) % radix_index].push_back(c);
 		// but using the operator >> and & can be more efficient
-		bucket[c >> (n * radix_binary) & (radix_index - 1)].push_back(c);
+		bucket[unsigned_of(c) >> (n * radix_binary) & (radix_index - 1)].push_back(c);
 	}
+	Stats::move(vec.size());
+	Stats::pass(true);
 	if (n)
 	{
 		for (auto& c : bucket)
 		{
-			counting_sort_multi_pro<T>(c, n - 1);
+			// a bucket with less than two elements is already sorted
+			if (c.size() > 1) counting_sort_multi_pro<T, Stats>(c, n - 1);
 		}
 	}
 	for (size_t i = 1; i != radix_index; i++)
 	{
 		before_number[i] = before_number[i - 1] + bucket[i - 1].size();
 	}
+	radix_buckets<Stats>(before_number, radix_index, vec.size());
+	auto out = vec.begin();
 	for (size_t i = 0; i != radix_index; i++)
 	{
 		for (size_t j = 0; j != bucket[i].size(); j++)
 		{
-			vec[before_number[i] + j] = bucket[i][j]; // store the numbers by sequence
+			*out++ = bucket[i][j]; // store the numbers by sequence
 		}
 	}
+	Stats::move(vec.size());
 }
 
 /**
@@ -755,34 +1667,52 @@ void counting_sort_multi_pro(T& vec, size_t n)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list' and 'array'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void LSD_sort(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void LSD_sort(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"LSD_sort can not be applied to non-integer value types.")) return;
+	TVJ_SORT_PHASE("LSD_sort");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 	if (!isUnsigned<T>())
 	{
-		max_one -= min_one; // every number is no less than zero now
 		for (auto& c : vec)
 		{
-			c -= min_one;
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
 		}
 	}
-	for (int i = 0; i != std::to_string(max_one).length(); i++)
+	TVJ_SORT_STEP("passes");
+	// the buckets of a pass may hold up to 3 times the elements while they grow
+	if (!radix_budget_passes<T, Stats>(vec, range, budget, 3 * vec.size() * sizeof(typename T::value_type)))
 	{
-		counting_sort_one<T>(vec, i);
+		for (int i = 0; i != decimal_digits(range) && !Stats::stop(); i++)
+		{
+			counting_sort_one<T, Stats>(vec, i);
+			Stats::progress(i + 1, decimal_digits(range));
+		}
 	}
-	for (auto& c : vec)
+	TVJ_SORT_STEP("restore");
+	if (!isUnsigned<T>())
 	{
-		// return the elements to the original value
-		c += min_one;
+		for (auto& c : vec)
+		{
+			// return the elements to the original value
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
+		}
 	}
 }
 
@@ -791,42 +1721,53 @@ void LSD_sort(T& vec)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list' and 'array'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void LSD_sort_pro(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void LSD_sort_pro(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"LSD_sort_pro can not be applied to non-integer value types.")) return;
+	TVJ_SORT_PHASE("LSD_sort_pro");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 	if (!isUnsigned<T>())
 	{
-		max_one -= min_one; // every number is no less than zero now
 		for (auto& c : vec)
 		{
-			c -= min_one;
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
 		}
 	}
-	// If max_one is zero, log(max_one) will be illegal.
-	// But this time, it is already sorted
+	TVJ_SORT_STEP("passes");
+	// If range is zero, it is already sorted
 	// as all the elements are equal.
-	if (max_one)
+	// the buckets of a pass may hold up to 3 times the elements while they grow
+	if (range && !radix_budget_passes<T, Stats>(vec, range, budget, 3 * vec.size() * sizeof(typename T::value_type)))
 	{
-		for (int i = 0; i != static_cast<typename T::value_type>(log(max_one) / log(radix_index)) + 1; i++)
+		for (int i = 0; i != radix_passes(range) && !Stats::stop(); i++)
 		{
-			counting_sort_one_pro<T>(vec, i);
+			counting_sort_one_pro<T, Stats>(vec, i);
+			Stats::progress(i + 1, radix_passes(range));
 		}
 	}
+	TVJ_SORT_STEP("restore");
 	if (!isUnsigned<T>())
 	{
 		for (auto& c : vec)
 		{
 			// return the elements to the original value
-			c += min_one;
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
 		}
 	}
 }
@@ -836,30 +1777,56 @@ void LSD_sort_pro(T& vec)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list' and 'array'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void MSD_sort(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void MSD_sort(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"MSD_sort can not be applied to non-integer value types.")) return;
+	size_t staged = vec.size() * sizeof(typename T::value_type);
+	if (is_segmented<T>::value && staged <= budget)
+	{
+		// the buckets would be deques as well
+		staged_sort<T, Stats>(vec, [=](staged_vector<T>& v) { MSD_sort<staged_vector<T>, Stats>(v, budget - staged); });
+		return;
+	}
+	TVJ_SORT_PHASE("MSD_sort");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 
-	max_one -= min_one; // every number is no less than zero now
-	for (auto& c : vec)
+	if (!isUnsigned<T>())
 	{
-		c -= min_one;
+		for (auto& c : vec)
+		{
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
+		}
 	}
-
-	counting_sort_multi<T>(vec, std::to_string(max_one).length() - 1);
-	for (auto& c : vec)
+	TVJ_SORT_STEP("passes");
+	// every level keeps its buckets (up to twice the elements) while the next one sorts
+	if (!radix_budget_passes<T, Stats>(vec, range, budget, (2 * decimal_digits(range) + 1) * vec.size() * sizeof(typename T::value_type)))
 	{
-		// return the elements to the original value
-		c += min_one;
+		counting_sort_multi<T, Stats>(vec, decimal_digits(range) - 1);
+	}
+	TVJ_SORT_STEP("restore");
+	if (!isUnsigned<T>())
+	{
+		for (auto& c : vec)
+		{
+			// return the elements to the original value
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
+		}
 	}
 }
 
@@ -868,39 +1835,56 @@ void MSD_sort(T& vec)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list' and 'array'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void MSD_sort_pro(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void MSD_sort_pro(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"MSD_sort_pro can not be applied to non-integer value types.")) return;
+	size_t staged = vec.size() * sizeof(typename T::value_type);
+	if (is_segmented<T>::value && staged <= budget)
+	{
+		// the buckets would be deques as well
+		staged_sort<T, Stats>(vec, [=](staged_vector<T>& v) { MSD_sort_pro<staged_vector<T>, Stats>(v, budget - staged); });
+		return;
+	}
+	TVJ_SORT_PHASE("MSD_sort_pro");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 	if (!isUnsigned<T>())
 	{
-		max_one -= min_one; // every number is no less than zero now
 		for (auto& c : vec)
 		{
-			c -= min_one;
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
 		}
 	}
-	// If max_one is zero, log(max_one) will be illegal.
-	// But this time, it is already sorted
+	TVJ_SORT_STEP("passes");
+	// If range is zero, it is already sorted
 	// as all the elements are equal.
-	if (max_one) // if (max_one != 0)
+	// every level keeps its buckets (up to twice the elements) while the next one sorts
+	if (range && !radix_budget_passes<T, Stats>(vec, range, budget, (2 * radix_passes(range) + 1) * vec.size() * sizeof(typename T::value_type)))
 	{
-		counting_sort_multi_pro<T>(vec, static_cast<int>(log(max_one) / log(radix_index)));
+		counting_sort_multi_pro<T, Stats>(vec, radix_passes(range) - 1);
 	}
+	TVJ_SORT_STEP("restore");
 	if (!isUnsigned<T>())
 	{
 		for (auto& c : vec)
 		{
 			// return the elements to the original value
-			c += min_one;
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
 		}
 	}
 }
@@ -910,42 +1894,53 @@ void MSD_sort_pro(T& vec)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void LSD_sort_pro_heap1(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void LSD_sort_pro_heap1(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"LSD_sort_pro_heap1 can not be applied to non-integer value types.")) return;
+	TVJ_SORT_PHASE("LSD_sort_pro_heap1");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 	if (!isUnsigned<T>())
 	{
-		max_one -= min_one; // every number is no less than zero now
 		for (auto& c : vec)
 		{
-			c -= min_one;
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
 		}
 	}
-	// If max_one is zero, log(max_one) will be illegal.
-	// But this time, it is already sorted
+	TVJ_SORT_STEP("passes");
+	// If range is zero, it is already sorted
 	// as all the elements are equal.
-	if (max_one)
+	// the buckets of a pass may hold up to 3 times the elements while they grow
+	if (range && !radix_budget_passes<T, Stats>(vec, range, budget, (3 * vec.size() + radix_index * 32) * sizeof(typename T::value_type)))
 	{
-		for (int i = 0; i != static_cast<typename T::value_type>(log(max_one) / log(radix_index)) + 1; i++)
+		for (int i = 0; i != radix_passes(range) && !Stats::stop(); i++)
 		{
-			counting_sort_one_pro_heap1<T>(vec, i);
+			counting_sort_one_pro_heap1<T, Stats>(vec, i);
+			Stats::progress(i + 1, radix_passes(range));
 		}
 	}
+	TVJ_SORT_STEP("restore");
 	if (!isUnsigned<T>())
 	{
 		for (auto& c : vec)
 		{
 			// return the elements to the original value
-			c += min_one;
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
 		}
 	}
 }
@@ -955,42 +1950,52 @@ void LSD_sort_pro_heap1(T& vec)
  * Used to sort integers.
  * Must support [].
  * Do not support 'list' and 'array'.
+ * The scratch memory stays within budget bytes (see radix_budget_passes).
  * return void
  */
-template<typename T>
-void LSD_sort_pro_heap2(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+void LSD_sort_pro_heap2(T& vec, size_t budget = sort_budget_unlimited)
 {
 	if (!check_type<T>(L"MSD_sort_pro_heap2 can not be applied to non-integer value types.")) return;
+	TVJ_SORT_PHASE("LSD_sort_pro_heap2");
+	TVJ_SORT_STEP_FIRST("range");
 	auto max_one = vec[0], min_one = vec[0];
 	for (const auto& c : vec)
 	{
 		max_one = my_max(max_one, c);
 		min_one = my_min(min_one, c);
 	}
+	// the range is computed in the unsigned type so that it can not overflow
+	auto range = unsigned_of(max_one);
+	if (!isUnsigned<T>()) range -= unsigned_of(min_one);
+	// a small range is counted directly
+	if (counting_sort_direct<T, Stats>(vec, min_one, max_one, budget)) return;
 	if (!isUnsigned<T>())
 	{
-		max_one -= min_one; // every number is no less than zero now
 		for (auto& c : vec)
 		{
-			c -= min_one;
+			// every number is no less than zero now (in the unsigned view)
+			c = static_cast<typename T::value_type>(unsigned_of(c) - unsigned_of(min_one));
 		}
 	}
-	// If max_one is zero, log(max_one) will be illegal.
-	// But this time, it is already sorted
+	TVJ_SORT_STEP("passes");
+	// If range is zero, it is already sorted
 	// as all the elements are equal.
-	if (max_one) // if (max_one != 0)
+	if (range && !radix_budget_passes<T, Stats>(vec, range, budget, vec.size() * sizeof(typename T::value_type)))
 	{
-		for (int i = 0; i != static_cast<int>(log(max_one) / log(radix_index)) + 1; i++)
+		for (int i = 0; i != radix_passes(range) && !Stats::stop(); i++)
 		{
-			counting_sort_one_pro_heap2<T>(vec, i);
+			counting_sort_one_pro_heap2<T, Stats>(vec, i);
+			Stats::progress(i + 1, radix_passes(range));
 		}
 	}
+	TVJ_SORT_STEP("restore");
 	if (!isUnsigned<T>())
 	{
 		for (auto& c : vec)
 		{
 			// return the elements to the original value
-			c += min_one;
+			c = static_cast<typename T::value_type>(unsigned_of(c) + unsigned_of(min_one));
 		}
 	}
 }
@@ -1001,18 +2006,20 @@ void LSD_sort_pro_heap2(T& vec)
  * when [i_beg + 1, i_end) is already adjusted
  * return void
  */
-template<typename T>
-void heap_adjust(std::vector<T>& vec, size_t i_beg, size_t i_end)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void heap_adjust(std::vector<T>& vec, size_t i_beg, size_t i_end)
 {
 	auto rc = vec[i_beg];
 	for (size_t i = 2 * i_beg; i < i_end; i *= 2)
 	{
-		if (i + 1 != i_end && vec[i] < vec[i + 1]) i++; // i is now the larger one of two children
-		if (rc >= vec[i]) break;                   // at the right place
+		if (i + 1 != i_end && Stats::less(vec[i], vec[i + 1])) i++; // i is now the larger one of two children
+		if (Stats::greater_equal(rc, vec[i])) break; // at the right place
 		vec[i_beg] = vec[i];
+		Stats::move();
 		i_beg = i;
 	}
 	vec[i_beg] = rc; // insert the element here
+	Stats::move();
 }
 
 /**
@@ -1020,13 +2027,15 @@ void heap_adjust(std::vector<T>& vec, size_t i_beg, size_t i_end)
  * create the heap (adjust all)
  * return void
  */
-template<typename T>
-void create_heap(std::vector<T>& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void create_heap(std::vector<T>& vec)
 {
 	auto vec_size = vec.size();
-	for (auto i = vec_size / 2; i != 0; i--)
+	// the children of i are 2 * i and 2 * i + 1,
+	// so the last parent is at vec_size / 2
+	for (auto i = vec_size / 2 + 1; i != 0; i--)
 	{
-		heap_adjust(vec, i - 1, vec_size);
+		heap_adjust<T, Stats>(vec, i - 1, vec_size);
 	}
 }
 
@@ -1036,21 +2045,24 @@ void create_heap(std::vector<T>& vec)
  * Argument 2: the end iterator
  * return void
  */
-template<typename T>
-void heap_sort(vec_iter<T> i, vec_iter<T> j)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void heap_sort(vec_iter<T> i, vec_iter<T> j)
 {
 	std::vector<typename T::value_type> heap(i, j);
-	create_heap(heap);
+	Stats::allocate(heap.size() * sizeof(typename T::value_type));
+	Stats::move(heap.size());
+	create_heap<typename T::value_type, Stats>(heap);
 	for (size_t index = heap.size(); index > 0; index--)
 	{
-		my_swap(heap[0], heap[index - 1]); // swap the top element with the last element
-		heap_adjust(heap, 0, index - 1);   // adjust the remaining elements of heap into max heap
+		my_swap<Stats>(heap[0], heap[index - 1]); // swap the top element with the last element
+		heap_adjust<typename T::value_type, Stats>(heap, 0, index - 1); // adjust the remaining elements of heap into max heap
 	}
 	auto heap_iter = heap.begin();
 	for (auto iter = i; iter != j; iter++, heap_iter++)
 	{
 		*iter = *heap_iter;
 	}
+	Stats::move(heap.size());
 }
 
 /**
@@ -1059,19 +2071,138 @@ void heap_sort(vec_iter<T> i, vec_iter<T> j)
  * Argument 2: the end pointer
  * return void
  */
-template<typename T>
-void heap_sort(T* i, T* j)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void heap_sort(T* i, T* j)
 {
-	std::vector<T&> heap;
-	for (auto iter = i; i != j; iter++)
+	std::vector<T> heap(i, j);
+	Stats::allocate(heap.size() * sizeof(T));
+	Stats::move(heap.size());
+	create_heap<T, Stats>(heap);
+	for (size_t index = heap.size(); index > 0; index--)
 	{
-		heap.push_back(*iter);
+		my_swap<Stats>(heap[0], heap[index - 1]); // swap the top element with the last element
+		heap_adjust<T, Stats>(heap, 0, index - 1); // adjust the remaining elements of heap into max heap
 	}
-	create_heap(heap);
-	for (size_t index = heap.size(); index > 0; index--)
+	auto heap_iter = heap.begin();
+	for (auto iter = i; iter != j; iter++, heap_iter++)
+	{
+		*iter = *heap_iter;
+	}
+	Stats::move(heap.size());
+}
+
+/**
+ * list merge
+ * Merge the sorted runs of n1 nodes from first and n2 nodes from second
+ * (right after the first run) of a std::list by relinking the nodes
+ * of the second run (stable).
+ * return the first node of the merged run
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+vec_iter<T> list_merge(T& list, vec_iter<T> first, vec_iter<T> second, size_t n1, size_t n2)
+{
+	auto i = first, j = second;
+	while (n1 && n2)
+	{
+		if (Stats::less(*j, *i))
+		{
+			auto node = j++;
+			if (i == first) first = node;
+			list.splice(i, list, node); // move the node in front of i
+			n2--;
+		}
+		else
+		{
+			i++;
+			n1--;
+		}
+	}
+	return first;
+}
+
+/**
+ * list merge after
+ * Merge the sorted runs of n1 nodes after 'before' (ending at 'last')
+ * and n2 nodes after 'last' (ending at 'tail') of a std::forward_list
+ * by relinking the nodes of the second run (stable).
+ * return the last node of the merged run
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+vec_iter<T> list_merge_after(T& list, vec_iter<T> before, vec_iter<T> last, vec_iter<T> tail, size_t n1, size_t n2)
+{
+	while (n1 && n2)
+	{
+		if (Stats::less(*std::next(last), *std::next(before)))
+		{
+			list.splice_after(before, list, last); // move the node after last behind before
+			n2--;
+		}
+		else n1--;
+		before++;
+	}
+	return n2 ? tail : last;
+}
+
+/**
+ * list sort (std::list)
+ * The bottom-up merge sort on a stack of sorted runs,
+ * whose sizes are like the bits of a binary counter.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void list_sort(T& list, std::bidirectional_iterator_tag)
+{
+	vec_iter<T> first[8 * sizeof(size_t) + 1]; // the first node of each run
+	size_t size[8 * sizeof(size_t) + 1];       // the number of nodes of each run
+	size_t runs = 0;
+	for (auto iter = list.begin(); iter != list.end(); runs++)
+	{
+		first[runs] = iter++;
+		size[runs] = 1;
+		// merge the runs of the same size
+		while (runs != 0 && size[runs - 1] <= size[runs])
+		{
+			first[runs - 1] = list_merge<T, Stats>(list, first[runs - 1], first[runs], size[runs - 1], size[runs]);
+			size[runs - 1] += size[runs];
+			runs--;
+		}
+	}
+	for (; runs > 1; runs--)
+	{
+		first[runs - 2] = list_merge<T, Stats>(list, first[runs - 2], first[runs - 1], size[runs - 2], size[runs - 1]);
+		size[runs - 2] += size[runs - 1];
+	}
+}
+
+/**
+ * list sort (std::forward_list)
+ * The same as above, but each run is kept by the node before it.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void list_sort(T& list, std::forward_iterator_tag)
+{
+	vec_iter<T> before[8 * sizeof(size_t) + 1]; // the node before each run (the last node of the previous one)
+	size_t size[8 * sizeof(size_t) + 1];        // the number of nodes of each run
+	size_t runs = 0;
+	auto last = list.before_begin();            // the last node of the last run
+	for (auto iter = list.begin(); iter != list.end(); runs++)
+	{
+		before[runs] = last;
+		size[runs] = 1;
+		last = iter++;
+		// merge the runs of the same size
+		while (runs != 0 && size[runs - 1] <= size[runs])
+		{
+			last = list_merge_after<T, Stats>(list, before[runs - 1], before[runs], last, size[runs - 1], size[runs]);
+			size[runs - 1] += size[runs];
+			runs--;
+		}
+	}
+	for (; runs > 1; runs--)
 	{
-		my_swap(heap[0], heap[index - 1]); // swap the top element with the last element
-		heap_adjust(heap, 0, index - 1);   // adjust the remaining elements of heap into max heap
+		last = list_merge_after<T, Stats>(list, before[runs - 2], before[runs - 1], last, size[runs - 2], size[runs - 1]);
+		size[runs - 2] += size[runs - 1];
 	}
 }
 
@@ -1080,10 +2211,11 @@ void heap_sort(T* i, T* j)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void bubble_sort(T& vec)
 {
-	bubble_sort<T>(vec.begin(), vec.end());
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { bubble_sort<staged_vector<T>, Stats>(v); });
+	else bubble_sort<T, Stats>(vec.begin(), vec.end());
 }
 
 /**
@@ -1091,10 +2223,11 @@ void bubble_sort(T& vec)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
-void insertion_sort(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void insertion_sort(T& vec)
 {
-	insertion_sort<T>(vec.begin(), vec.end());
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { insertion_sort<staged_vector<T>, Stats>(v); });
+	else insertion_sort<T, Stats>(vec.begin(), vec.end());
 }
 
 /**
@@ -1102,10 +2235,11 @@ void insertion_sort(T& vec)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void quick_sort(T& vec)
 {
-	quick_sort<T>(vec, vec.begin(), vec.end());
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { quick_sort<staged_vector<T>, Stats>(v); });
+	else quick_sort<T, Stats>(vec, vec.begin(), vec.end());
 }
 
 /**
@@ -1113,10 +2247,11 @@ void quick_sort(T& vec)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
+template<typename T, typename Stats = Sort_Stats_Null>
 void quick_sort_pro(T& vec)
 {
-	quick_sort_pro<T>(vec.begin(), vec.end());
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { quick_sort_pro<staged_vector<T>, Stats>(v); });
+	else quick_sort_pro<T, Stats>(vec.begin(), vec.end());
 }
 
 /**
@@ -1124,10 +2259,11 @@ void quick_sort_pro(T& vec)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
-void quick_sort_pro_safe(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void quick_sort_pro_safe(T& vec)
 {
-	quick_sort_pro_safe<T>(vec.begin(), vec.end());
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { quick_sort_pro_safe<staged_vector<T>, Stats>(v); });
+	else quick_sort_pro_safe<T, Stats>(vec.begin(), vec.end());
 }
 
 /**
@@ -1135,12 +2271,2334 @@ void quick_sort_pro_safe(T& vec)
  * Only for containers with iterators
  * return void
  */
-template<typename T>
-void heap_sort(T& vec)
+template<typename T, typename Stats = Sort_Stats_Null>
+TVJ_CONSTEXPR20 void heap_sort(T& vec)
+{
+	heap_sort<T, Stats>(vec.begin(), vec.end());
+}
+
+/**
+ * Sort_Lazy
+ * Sorted iteration over a container that sorts only as far as it is read
+ * (incremental quicksort): to settle the next element, the part in front of
+ * the nearest settled pivot is partitioned by quick_partition until the pivot lands there.
+ * The pivots are ninthers (the medium of three mediums of three), so the first k elements
+ * are expected to cost O(n + k log k); a part that has been partitioned more than 2 log2(n) times
+ * is read off a heap instead, so that no input costs more than O(n log n). Stopping early costs nothing.
+ * The container is reordered in place; [begin, begin + sorted()) is sorted.
+ * Must support [] (random access iterators).
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+class Sort_Lazy
+{
+public:
+	typedef typename T::value_type value_type;
+
+	Sort_Lazy(T& vec) : vec_(vec), next_(0), settled_(0), heap_(0), limit_(0)
+	{
+		pivots_.push_back(Pivot{ vec.size(), 0 }); // as if a pivot were just past the end
+		for (size_t n = vec.size(); n > 1; n >>= 1) limit_ += 2;
+	}
+
+	// whether every element has been read
+	inline bool done() const
+	{
+		return next_ == vec_.size();
+	}
+
+	// the number of elements read
+	inline size_t sorted() const
+	{
+		return next_;
+	}
+
+	// the next element in order (not done)
+	const value_type& peek()
+	{
+		settle();
+		return vec_[next_];
+	}
+
+	// read the next element in order (not done)
+	const value_type& next()
+	{
+		settle();
+		return vec_[next_++];
+	}
+
+	// an input iterator over the elements not read yet
+	class iterator
+	{
+	public:
+		typedef std::input_iterator_tag iterator_category;
+		typedef typename T::value_type value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const value_type* pointer;
+		typedef const value_type& reference;
+
+		iterator(Sort_Lazy* lazy = nullptr) : lazy_(lazy) { }
+		reference operator *() const { return lazy_->peek(); }
+		pointer operator ->() const { return &lazy_->peek(); }
+		iterator& operator ++()
+		{
+			lazy_->next();
+			return *this;
+		}
+		void operator ++(int) { lazy_->next(); }
+		// every iterator is at the same place, so only the end differs
+		bool operator ==(const iterator& other) const { return at_end() == other.at_end(); }
+		bool operator !=(const iterator& other) const { return at_end() != other.at_end(); }
+
+	private:
+		Sort_Lazy* lazy_;
+		bool at_end() const { return !lazy_ || lazy_->done(); }
+	};
+
+	iterator begin()
+	{
+		return iterator(this);
+	}
+
+	iterator end()
+	{
+		return iterator();
+	}
+
+private:
+	T& vec_;
+	size_t next_;                // the next element to read
+	size_t settled_;             // [0, settled_) is in its sorted place
+	struct Pivot
+	{
+		size_t at;    // where the pivot is
+		size_t depth; // how many times the part in front of it has been partitioned
+	};
+	std::vector<Pivot> pivots_;  // the settled pivots after next_, the nearest last
+	size_t heap_;                // if not 0, [next_, the nearest pivot) is a heap of this size
+	size_t limit_;               // the depth from which a part is read off a heap
+
+	// the ninther of [i, j), or the medium of three for a small part
+	vec_iter<T> choose_pivot(size_t i, size_t j)
+	{
+		auto first = vec_.begin() + i;
+		auto last = vec_.begin() + (j - 1);
+		auto middle = first + (j - i - 1) / 2;
+		if (j - i < 128) return medium<T, Stats>(first, last, middle);
+		size_t step = (j - i) / 8;
+		return medium<T, Stats>(medium<T, Stats>(first, first + step, first + 2 * step),
+			medium<T, Stats>(middle - step, middle, middle + step),
+			medium<T, Stats>(last - 2 * step, last - step, last));
+	}
+
+	// Sift down in the heap whose place h is vec_[base - h], no larger than its children,
+	// so that its root is at the end of the part and its last place at next_.
+	void sift_down(size_t base, size_t h, size_t size)
+	{
+		for (size_t c = 2 * h + 1; c < size; h = c, c = 2 * h + 1)
+		{
+			if (c + 1 < size && Stats::less(vec_[base - (c + 1)], vec_[base - c])) c++;
+			if (!Stats::less(vec_[base - c], vec_[base - h])) break;
+			my_swap<Stats>(vec_[base - h], vec_[base - c]);
+		}
+	}
+
+	// put the element at next_ in its sorted place
+	void settle()
+	{
+		while (next_ >= settled_)
+		{
+			size_t pivot = pivots_.back().at;
+			size_t depth = pivots_.back().depth;
+			if (pivot == next_)
+			{
+				pivots_.pop_back();
+				settled_ = next_ + 1;
+			}
+			else if (heap_)
+			{
+				// The root is the smallest, and the last place of the heap is next_.
+				my_swap<Stats>(vec_[pivot - 1], vec_[next_]);
+				sift_down(pivot - 1, 0, --heap_);
+				settled_ = next_ + 1;
+			}
+			else if (pivot - next_ <= 16)
+			{
+				// If the number is not large,
+				// insertion sort can be more efficient.
+				insertion_sort<T, Stats>(vec_.begin() + next_, vec_.begin() + pivot);
+				settled_ = pivot;
+			}
+			else if (depth >= limit_)
+			{
+				// The pivots keep splitting the part badly,
+				// so read the rest of it off a heap.
+				heap_ = pivot - next_;
+				for (size_t h = heap_ / 2; h-- > 0; ) sift_down(pivot - 1, h, heap_);
+			}
+			else
+			{
+				size_t at = quick_partition<T, Stats>(vec_.begin() + next_, vec_.begin() + pivot, choose_pivot(next_, pivot)) - vec_.begin();
+				// both the part in front of the new pivot and the one after it are a level deeper
+				pivots_.back().depth = depth + 1;
+				pivots_.push_back(Pivot{ at, depth + 1 });
+			}
+		}
+	}
+};
+
+/**
+ * sort lazy
+ * Iterate over vec in sorted order, sorting only as far as it is read (see Sort_Lazy),
+ * e.g. for (auto c : sort_lazy(vec)) { if (...) break; }
+ * return Sort_Lazy
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+Sort_Lazy<T, Stats> sort_lazy(T& vec)
+{
+	return Sort_Lazy<T, Stats>(vec);
+}
+
+/**
+ * list sort
+ * Only for std::list and std::forward_list.
+ * The nodes are relinked, so no element is copied or moved,
+ * nothing is allocated, and equal elements keep their order.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void list_sort(T& list)
 {
-	heap_sort<T>(vec.begin(), vec.end());
+	list_sort<T, Stats>(list, typename std::iterator_traits<vec_iter<T>>::iterator_category());
 }
 
+/**
+ * Argsort_Ref
+ * An element and its index, compared by the element first
+ * and then by the index, so that argsort is stable.
+ */
+template<typename V, typename Index>
+struct Argsort_Ref
+{
+	const V* value;
+	Index index;
+	bool operator<(const Argsort_Ref& r) const  { return *value < *r.value || (!(*r.value < *value) && index < r.index); }
+	bool operator>(const Argsort_Ref& r) const  { return r < *this; }
+	bool operator<=(const Argsort_Ref& r) const { return !(r < *this); }
+	bool operator>=(const Argsort_Ref& r) const { return !(*this < r); }
+};
+
+/**
+ * argsort (comparison)
+ * Sort the references to the elements with quick_sort_pro_safe.
+ * return void
+ */
+template<typename T, typename Index, typename Stats = Sort_Stats_Null>
+void argsort(const T& vec, std::vector<Index>& order, std::false_type)
+{
+	typedef Argsort_Ref<typename T::value_type, Index> Ref;
+	std::vector<Ref> refs;
+	refs.reserve(vec.size());
+	Stats::allocate(vec.size() * sizeof(Ref));
+	Index index = 0;
+	for (const auto& c : vec)
+		refs.push_back(Ref{ &c, index++ });
+	quick_sort_pro_safe<std::vector<Ref>, Stats>(refs);
+	for (size_t i = 0; i != refs.size(); i++)
+		order[i] = refs[i].index;
+}
+
+/**
+ * argsort (integer)
+ * LSD radix sort of the keys (offset by the minimum) with the indices,
+ * which is stable. A digit all the keys share is skipped.
+ * return void
+ */
+template<typename T, typename Index, typename Stats = Sort_Stats_Null>
+void argsort(const T& vec, std::vector<Index>& order, std::true_type)
+{
+	typedef typename std::make_unsigned<typename std::decay<typename T::value_type>::type>::type U;
+	const size_t n = vec.size();
+	TVJ_SORT_PHASE("argsort");
+	TVJ_SORT_STEP_FIRST("range");
+	auto max_one = *vec.begin(), min_one = *vec.begin();
+	for (const auto& c : vec)
+	{
+		max_one = my_max(max_one, c);
+		min_one = my_min(min_one, c);
+	}
+	U range = unsigned_of(max_one) - unsigned_of(min_one);
+	std::vector<U> key(n), key_buffer(n);
+	std::vector<Index> order_buffer(n);
+	Stats::allocate(n * (2 * sizeof(U) + sizeof(Index)));
+	size_t i = 0;
+	for (const auto& c : vec)
+	{
+		key[i] = unsigned_of(c) - unsigned_of(min_one);
+		order[i] = static_cast<Index>(i);
+		i++;
+	}
+	TVJ_SORT_STEP("passes");
+	for (int pass = 0; pass != radix_passes(range); pass++)
+	{
+		const int shift = pass * radix_binary;
+		size_t before_number[radix_index]{ 0 };
+		for (i = 0; i != n; i++)
+			before_number[key[i] >> shift & (radix_index - 1)]++;
+		// If all the keys are in one bucket, nothing moves.
+		bool taken = before_number[key[0] >> shift & (radix_index - 1)] != n;
+		Stats::pass(taken);
+		if (!taken) continue;
+		size_t sum = 0;
+		for (auto& c : before_number)
+		{
+			auto count = c;
+			c = sum;
+			sum += count;
+		}
+		radix_buckets<Stats>(before_number, radix_index, n);
+		for (i = 0; i != n; i++)
+		{
+			auto& to = before_number[key[i] >> shift & (radix_index - 1)];
+			key_buffer[to] = key[i];
+			order_buffer[to++] = order[i];
+		}
+		Stats::move(n);
+		key.swap(key_buffer);
+		order.swap(order_buffer);
+	}
+}
+
+/**
+ * argsort
+ * The permutation that sorts vec (stably): vec[order[0]] is the smallest.
+ * Integers are sorted by radix, other types by quick_sort_pro_safe.
+ * Index is uint32_t or uint64_t (for more than 2^32 - 1 elements);
+ * the result is empty if Index is too small for the size.
+ * return std::vector<Index>
+ */
+template<typename T, typename Index = uint32_t, typename Stats = Sort_Stats_Null>
+std::vector<Index> argsort(const T& vec)
+{
+	typedef typename std::decay<typename T::value_type>::type V;
+	size_t n = std::distance(vec.begin(), vec.end());
+	if (n - 1 > static_cast<size_t>(static_cast<Index>(-1))) return std::vector<Index>();
+	std::vector<Index> order(n);
+	if (n == 0) return order;
+	argsort<T, Index, Stats>(vec, order, std::integral_constant<bool, std::is_integral<V>::value && !std::is_same<V, bool>::value>());
+	return order;
+}
+
+/**
+ * apply permutation
+ * Reorder vec in place so that the new vec[i] is the old vec[order[i]],
+ * by following the cycles of order: each element is moved once
+ * (plus one more for each cycle), and only one bit per element is allocated.
+ * order has to be a permutation of 0 .. size - 1, e.g. from argsort;
+ * nothing is done if the sizes differ.
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename Index, typename T>
+void apply_permutation(const std::vector<Index>& order, T& vec)
+{
+	const size_t n = order.size();
+	if (n != static_cast<size_t>(std::distance(vec.begin(), vec.end()))) return;
+	std::vector<bool> done(n);
+	for (size_t i = 0; i != n; i++)
+	{
+		if (done[i]) continue;
+		done[i] = true;
+		if (order[i] == i) continue;
+		auto temp = std::move(vec[i]);
+		size_t j = i;
+		for (size_t k = order[j]; k != i; j = k, k = order[j])
+		{
+			vec[j] = std::move(vec[k]);
+			Stats::move();
+			done[k] = true;
+		}
+		vec[j] = std::move(temp);
+		Stats::move(2);
+	}
+}
+
+/**
+ * apply permutation
+ * Reorder several containers (columns) of the same size with one permutation.
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename Index, typename T, typename... Rest>
+void apply_permutation(const std::vector<Index>& order, T& vec, Rest&... rest)
+{
+	apply_permutation<Stats>(order, vec);
+	apply_permutation<Stats>(order, rest...);
+}
+
+/**
+ * column integral
+ * Whether the column is sorted by radix (an integer, but not bool) or by comparison.
+ */
+template<typename C>
+using column_integral = std::integral_constant<bool,
+	std::is_integral<typename std::decay<typename C::value_type>::type>::value &&
+	!std::is_same<typename std::decay<typename C::value_type>::type, bool>::value>;
+
+/**
+ * Column_Field
+ * An integer column of argsort_columns: its keys are offset by the minimum
+ * and take 'bits' bits from 'offset' on in the packed key of its pack.
+ * A column that is not an integer is sorted by comparison, alone.
+ */
+struct Column_Field
+{
+	bool integral = false;
+	uint64_t base = 0; // the minimum (in the unsigned view)
+	int bits = 0;      // of max - min
+	int offset = 0;
+};
+
+/**
+ * Column_Key
+ * The packed key of a row: the integer columns of a pack side by side,
+ * the last column in the lowest bits. word[0] is the least significant.
+ */
+template<size_t W>
+struct Column_Key
+{
+	uint64_t word[W];
+};
+
+/**
+ * for columns
+ * Call f(k, column) for every column in order, the first with k = 0.
+ * return void
+ */
+template<typename F, typename... C>
+void for_columns(F f, const C&... cols)
+{
+	size_t k = 0;
+	int unused[] = { 0, (f(k++, cols), 0)... };
+	(void)unused;
+	(void)f; // unused if there are no columns
+}
+
+/**
+ * column field (integer)
+ * Read the column once for its minimum and the bits of its range.
+ * return void
+ */
+template<typename C>
+void column_field(const C& col, Column_Field& field, std::true_type)
+{
+	typedef typename std::make_unsigned<typename std::decay<typename C::value_type>::type>::type U;
+	auto max_one = *col.begin(), min_one = *col.begin();
+	for (const auto& c : col)
+	{
+		max_one = my_max(max_one, c);
+		min_one = my_min(min_one, c);
+	}
+	U range = unsigned_of(max_one) - unsigned_of(min_one);
+	field.integral = true;
+	field.base = unsigned_of(min_one);
+	for (field.bits = 0; range; range >>= 1)
+		field.bits++;
+}
+
+/**
+ * column field
+ * return void
+ */
+template<typename C>
+void column_field(const C&, Column_Field& field, std::false_type)
+{
+	field.integral = false;
+}
+
+/**
+ * column fill (integer)
+ * Add the offset keys of the column to the packed keys of the rows,
+ * reading the column once from the beginning.
+ * return void
+ */
+template<size_t W, typename C>
+void column_fill(const C& col, const Column_Field& field, std::vector<Column_Key<W>>& key, std::true_type)
+{
+	typedef typename std::make_unsigned<typename std::decay<typename C::value_type>::type>::type U;
+	const size_t word = field.offset / 64;
+	const int shift = field.offset % 64;
+	// a column may straddle the two words of a 128-bit key
+	const bool split = shift && shift + field.bits > 64 && word + 1 < W;
+	auto c = col.begin();
+	for (size_t i = 0; i != key.size(); i++, ++c)
+	{
+		uint64_t value = static_cast<U>(unsigned_of(*c) - static_cast<U>(field.base));
+		key[i].word[word] |= value << shift;
+		if (split) key[i].word[word + 1] |= value >> (64 - shift);
+	}
+}
+
+/**
+ * column fill
+ * return void
+ */
+template<size_t W, typename C>
+void column_fill(const C&, const Column_Field&, std::vector<Column_Key<W>>&, std::false_type) { }
+
+/**
+ * column compare
+ * Sort order stably by one column that is not an integer:
+ * the references to the rows in the current order are sorted by
+ * the key and then by their position (see Argsort_Ref).
+ * return void
+ */
+template<typename Index, typename Stats = Sort_Stats_Null, typename C>
+void column_compare(const C& col, std::vector<Index>& order, std::false_type)
+{
+	typedef Argsort_Ref<typename C::value_type, Index> Ref;
+	const size_t n = order.size();
+	std::vector<Ref> refs;
+	refs.reserve(n);
+	Stats::allocate(n * (sizeof(Ref) + sizeof(Index)));
+	for (size_t i = 0; i != n; i++)
+		refs.push_back(Ref{ &col[order[i]], static_cast<Index>(i) });
+	quick_sort_pro_safe<std::vector<Ref>, Stats>(refs);
+	std::vector<Index> sorted(n);
+	for (size_t i = 0; i != n; i++)
+		sorted[i] = order[refs[i].index];
+	order.swap(sorted);
+}
+
+/**
+ * column compare
+ * return void
+ */
+template<typename Index, typename Stats = Sort_Stats_Null, typename C>
+void column_compare(const C&, std::vector<Index>&, std::true_type) { }
+
+/**
+ * column pack
+ * Sort order stably by the integer columns first ... last, packed into
+ * keys of W 64-bit words (bits in all): the keys are built column by column
+ * in the row order, taken in the current order (unless it is the identity),
+ * and sorted with the indices by LSD radix passes, skipping a digit all the keys share.
+ * return void
+ */
+template<size_t W, typename Index, typename Stats = Sort_Stats_Null, typename... C>
+void column_pack(std::vector<Index>& order, const std::vector<Column_Field>& fields,
+	size_t first, size_t last, int bits, bool identity, const C&... cols)
+{
+	const size_t n = order.size();
+	std::vector<Column_Key<W>> key(n, Column_Key<W>()), key_buffer(n);
+	std::vector<Index> order_buffer(n);
+	Stats::allocate(n * (2 * sizeof(Column_Key<W>) + sizeof(Index)));
+	for_columns([&](size_t k, const auto& col)
+	{
+		if (k >= first && k <= last)
+			column_fill<W>(col, fields[k], key, column_integral<typename std::decay<decltype(col)>::type>());
+	}, cols...);
+	if (!identity)
+	{
+		for (size_t i = 0; i != n; i++)
+			key_buffer[i] = key[order[i]];
+		key.swap(key_buffer);
+	}
+	for (int pass = 0; pass * radix_binary < bits && !Stats::stop(); pass++)
+	{
+		const size_t word = pass * radix_binary / 64;
+		const int shift = pass * radix_binary % 64;
+		size_t before_number[radix_index]{ 0 };
+		for (size_t i = 0; i != n; i++)
+			before_number[key[i].word[word] >> shift & (radix_index - 1)]++;
+		// If all the keys are in one bucket, nothing moves.
+		bool taken = before_number[key[0].word[word] >> shift & (radix_index - 1)] != n;
+		Stats::pass(taken);
+		if (!taken) continue;
+		size_t sum = 0;
+		for (auto& c : before_number)
+		{
+			auto count = c;
+			c = sum;
+			sum += count;
+		}
+		radix_buckets<Stats>(before_number, radix_index, n);
+		for (size_t i = 0; i != n; i++)
+		{
+			auto& to = before_number[key[i].word[word] >> shift & (radix_index - 1)];
+			key_buffer[to] = key[i];
+			order_buffer[to++] = order[i];
+		}
+		Stats::move(n);
+		key.swap(key_buffer);
+		order.swap(order_buffer);
+	}
+}
+
+/**
+ * argsort columns
+ * The permutation that sorts the rows of a table stored as columns
+ * (ORDER BY col, rest...): the rows order[0], order[1], ... are in
+ * lexicographic order of the columns, and rows equal in all of them keep their order.
+ * The columns are sorted from the last to the first, each stably after the one before (LSD).
+ * Neighbouring integer columns are offset by their minimum and packed into
+ * one key of 64 or 128 bits (as many as fit), sorted by radix,
+ * so a table whose integer keys fit in 128 bits needs one radix sort and no gather.
+ * Other columns are sorted by comparison (quick_sort_pro_safe over references).
+ * Every column is read from the beginning to the end, except for one gather
+ * of the keys of each later pack in the current order.
+ * The columns need [] and the same size; the result is empty otherwise,
+ * or if Index is too small for the size (see argsort).
+ * return std::vector<Index>
+ */
+template<typename Index = uint32_t, typename Stats = Sort_Stats_Null, typename C, typename... Rest>
+std::vector<Index> argsort_columns(const C& col, const Rest&... rest)
+{
+	const size_t n = col.size();
+	std::vector<Index> order;
+	bool same = true;
+	for_columns([&](size_t, const auto& c) { same = same && static_cast<size_t>(c.size()) == n; }, rest...);
+	if (!same || (n && n - 1 > static_cast<size_t>(static_cast<Index>(-1)))) return order;
+	order.resize(n);
+	for (size_t i = 0; i != n; i++)
+		order[i] = static_cast<Index>(i);
+	if (n < 2) return order;
+	TVJ_SORT_PHASE("argsort_columns");
+	TVJ_SORT_STEP_FIRST("range");
+	const size_t columns = 1 + sizeof...(Rest);
+	std::vector<Column_Field> fields(columns);
+	for_columns([&](size_t k, const auto& c)
+	{
+		column_field(c, fields[k], column_integral<typename std::decay<decltype(c)>::type>());
+	}, col, rest...);
+	TVJ_SORT_STEP("passes");
+	bool identity = true;
+	for (size_t end = columns; end != 0 && !Stats::stop(); )
+	{
+		size_t last = end - 1, first = last;
+		if (!fields[last].integral)
+		{
+			for_columns([&](size_t k, const auto& c)
+			{
+				if (k == last) column_compare<Index, Stats>(c, order, column_integral<typename std::decay<decltype(c)>::type>());
+			}, col, rest...);
+			identity = false;
+		}
+		else
+		{
+			// take the integer columns before it while they fit in 128 bits
+			int bits = fields[last].bits;
+			fields[last].offset = 0;
+			while (first != 0 && fields[first - 1].integral && bits + fields[first - 1].bits <= 128)
+			{
+				first--;
+				fields[first].offset = bits;
+				bits += fields[first].bits;
+			}
+			// If bits is zero, the columns are constant.
+			if (bits > 64) column_pack<2, Index, Stats>(order, fields, first, last, bits, identity, col, rest...);
+			else if (bits) column_pack<1, Index, Stats>(order, fields, first, last, bits, identity, col, rest...);
+			identity = identity && !bits;
+		}
+		end = first;
+	}
+	return order;
+}
+
+/**
+ * sort columns
+ * Sort the rows of a table stored as columns by the columns, from the first on
+ * (argsort_columns), and move every column into that order (apply_permutation).
+ * To reorder other columns with them, use argsort_columns and apply_permutation.
+ * return void
+ */
+template<typename Index = uint32_t, typename Stats = Sort_Stats_Null, typename... C>
+void sort_columns(C&... cols)
+{
+	std::vector<Index> order = argsort_columns<Index, Stats>(cols...);
+	if (order.empty()) return;
+	apply_permutation<Stats>(order, cols...);
+}
+
+/**
+ * sort group (comparison)
+ * Sort a copy with quick_sort_pro_safe and take every run of equal keys once.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_group(const T& vec, std::vector<typename T::value_type>& keys, std::vector<size_t>* counts, std::false_type)
+{
+	std::vector<typename T::value_type> work(vec.begin(), vec.end());
+	Stats::allocate(work.size() * sizeof(typename T::value_type));
+	quick_sort_pro_safe<std::vector<typename T::value_type>, Stats>(work);
+	for (auto& c : work)
+	{
+		if (keys.empty() || Stats::less(keys.back(), c))
+		{
+			keys.push_back(std::move(c));
+			if (counts) counts->push_back(1);
+		}
+		else if (counts) counts->back()++;
+	}
+}
+
+/**
+ * sort group (integer)
+ * Keys of a small range are only counted (counting_histogram).
+ * Others are sorted by LSD radix passes over a copy of the keys (offset by the minimum),
+ * and the runs are taken in the last pass: after the other passes, equal keys reach
+ * the bucket of their highest digit one after another, so the histogram of the last pass
+ * also counts the distinct keys of every bucket, and the pass writes each distinct key
+ * once, with its count, straight to its place in keys (and counts).
+ * So the sorted keys are never written out, and no pass is left to group them.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_group(const T& vec, std::vector<typename T::value_type>& keys, std::vector<size_t>* counts, std::true_type)
+{
+	typedef typename T::value_type V;
+	typedef typename std::make_unsigned<V>::type U;
+	const size_t n = vec.size();
+	TVJ_SORT_PHASE("sort_group");
+	TVJ_SORT_STEP_FIRST("range");
+	auto max_one = *vec.begin(), min_one = *vec.begin();
+	for (const auto& c : vec)
+	{
+		max_one = my_max(max_one, c);
+		min_one = my_min(min_one, c);
+	}
+	const U base = unsigned_of(min_one);
+	U range = unsigned_of(max_one) - base;
+	if (range < counting_range && range <= 2 * n + radix_index)
+	{
+		TVJ_SORT_STEP("histogram");
+		const size_t values = static_cast<size_t>(range) + 1;
+		std::vector<size_t> count(values);
+		Stats::allocate(values * sizeof(size_t));
+		counting_histogram(vec, base, values, count.data());
+		for (size_t k = 0; k != values; k++)
+		{
+			if (!count[k]) continue;
+			keys.push_back(static_cast<V>(static_cast<U>(base + k)));
+			if (counts) counts->push_back(count[k]);
+		}
+		return;
+	}
+	std::vector<U> key(n), key_buffer(n);
+	Stats::allocate(2 * n * sizeof(U));
+	size_t i = 0;
+	for (const auto& c : vec)
+		key[i++] = unsigned_of(c) - base;
+	TVJ_SORT_STEP("passes");
+	const int last = radix_passes(range) - 1;
+	for (int pass = 0; pass != last; pass++)
+	{
+		const int shift = pass * radix_binary;
+		size_t before_number[radix_index]{ 0 };
+		for (i = 0; i != n; i++)
+			before_number[key[i] >> shift & (radix_index - 1)]++;
+		// If all the keys are in one bucket, nothing moves.
+		bool taken = before_number[key[0] >> shift & (radix_index - 1)] != n;
+		Stats::pass(taken);
+		if (!taken) continue;
+		size_t sum = 0;
+		for (auto& c : before_number)
+		{
+			auto count = c;
+			c = sum;
+			sum += count;
+		}
+		radix_buckets<Stats>(before_number, radix_index, n);
+		for (i = 0; i != n; i++)
+			key_buffer[before_number[key[i] >> shift & (radix_index - 1)]++] = key[i];
+		Stats::move(n);
+		key.swap(key_buffer);
+	}
+	TVJ_SORT_STEP("group");
+	// The last pass: last_key[d] is the key that reached bucket d last,
+	// at first one of another bucket.
+	const int shift = last * radix_binary;
+	size_t before_number[radix_index]{ 0 }, distinct_number[radix_index]{ 0 };
+	U last_key[radix_index];
+	for (size_t d = 0; d != radix_index; d++)
+		last_key[d] = static_cast<U>(static_cast<U>(d ^ 1) << shift);
+	for (i = 0; i != n; i++)
+	{
+		const U c = key[i];
+		const size_t d = c >> shift & (radix_index - 1);
+		before_number[d]++;
+		distinct_number[d] += last_key[d] != c;
+		last_key[d] = c;
+	}
+	Stats::pass(true);
+	// the distinct keys of bucket d go to [before_number[d], ...) of keys
+	size_t sum = 0;
+	for (size_t d = 0; d != radix_index; d++)
+	{
+		before_number[d] = sum;
+		sum += distinct_number[d];
+		last_key[d] = static_cast<U>(static_cast<U>(d ^ 1) << shift);
+	}
+	keys.resize(sum);
+	if (counts) counts->resize(sum);
+	for (i = 0; i != n; i++)
+	{
+		const U c = key[i];
+		const size_t d = c >> shift & (radix_index - 1);
+		// a key equal to the last one of its bucket only adds to its count
+		const bool same = last_key[d] == c;
+		const size_t place = before_number[d] - same;
+		keys[place] = static_cast<V>(static_cast<U>(c + base));
+		if (counts) (*counts)[place] = same ? (*counts)[place] + 1 : 1;
+		before_number[d] = place + 1;
+		last_key[d] = c;
+	}
+	Stats::move(sum);
+}
+
+/**
+ * sort unique
+ * The distinct elements of vec in ascending order,
+ * like sorting a copy and removing the repeated elements, without writing the sorted copy.
+ * return std::vector<value_type>
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+std::vector<typename T::value_type> sort_unique(const T& vec)
+{
+	typedef typename T::value_type V;
+	std::vector<V> keys;
+	if (vec.begin() == vec.end()) return keys;
+	sort_group<T, Stats>(vec, keys, nullptr, std::integral_constant<bool, std::is_integral<V>::value && !std::is_same<V, bool>::value>());
+	return keys;
+}
+
+/**
+ * sort count
+ * The distinct elements of vec in ascending order, and in counts how many times each occurs
+ * (group by the element and count).
+ * return std::vector<value_type>
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+std::vector<typename T::value_type> sort_count(const T& vec, std::vector<size_t>& counts)
+{
+	typedef typename T::value_type V;
+	std::vector<V> keys;
+	counts.clear();
+	if (vec.begin() == vec.end()) return keys;
+	sort_group<T, Stats>(vec, keys, &counts, std::integral_constant<bool, std::is_integral<V>::value && !std::is_same<V, bool>::value>());
+	return keys;
+}
+
+/**
+ * radix sort copy
+ * LSD radix sort of a copy of src into dst (resized to the size of src), leaving src as it is.
+ * One read of src finds the range and the counts of every digit,
+ * so the digits all the elements share are known before any pass and skipped.
+ * The first pass scatters src, and the passes alternate between dst and one buffer
+ * so that the last one ends in dst; a small range is counted directly into dst.
+ * The sign bit is flipped in the digits of signed numbers instead of offsetting them.
+ * Only for integers (check_type); for other types, dst is an unsorted copy of src.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void radix_sort_copy(const T& src, std::vector<typename T::value_type>& dst)
+{
+	if (!check_type<T>(L"radix_sort_copy can not be applied to non-integer value types."))
+	{
+		// still a permutation of src, as the other radix sorts leave vec
+		dst.assign(src.begin(), src.end());
+		Stats::move(dst.size());
+		return;
+	}
+	typedef typename T::value_type V;
+	typedef typename std::make_unsigned<V>::type U;
+	const size_t n = src.size();
+	const int digits = sizeof(V);
+	dst.resize(n);
+	if (!n) return;
+	TVJ_SORT_PHASE("radix_sort_copy");
+	TVJ_SORT_STEP_FIRST("histogram");
+	const U flip = std::is_signed<V>::value ? static_cast<U>(static_cast<U>(1) << (8 * sizeof(U) - 1)) : 0;
+	size_t element_number[sizeof(V)][radix_index]{};
+	auto max_one = *src.begin(), min_one = *src.begin();
+	for (const auto& c : src)
+	{
+		max_one = my_max(max_one, c);
+		min_one = my_min(min_one, c);
+		U key = unsigned_of(c) ^ flip;
+		for (int d = 0; d != digits; d++)
+			element_number[d][key >> (d * radix_binary) & (radix_index - 1)]++;
+	}
+	const U base = unsigned_of(min_one), range = unsigned_of(max_one) - base;
+	if (range < counting_range && range <= 2 * n + radix_index)
+	{
+		// a small range is counted directly
+		TVJ_SORT_STEP("fill");
+		const size_t values = static_cast<size_t>(range) + 1;
+		std::vector<size_t> count(values);
+		Stats::allocate(values * sizeof(size_t));
+		counting_histogram(src, base, values, count.data());
+		auto out = dst.begin();
+		for (size_t k = 0; k != values; k++)
+			out = std::fill_n(out, count[k], static_cast<V>(static_cast<U>(base + k)));
+		Stats::move(n);
+		return;
+	}
+	// If all the elements are in one bucket of a digit, the pass is skipped.
+	int taken[sizeof(V)], passes = 0;
+	const U first_key = unsigned_of(*src.begin()) ^ flip;
+	for (int d = 0; d != digits; d++)
+	{
+		bool t = element_number[d][first_key >> (d * radix_binary) & (radix_index - 1)] != n;
+		Stats::pass(t);
+		if (t) taken[passes++] = d;
+	}
+	std::vector<V> buffer;
+	if (passes > 1)
+	{
+		buffer.resize(n);
+		Stats::allocate(n * sizeof(V));
+	}
+	TVJ_SORT_STEP("passes");
+	for (int j = 0; j != passes; j++)
+	{
+		const int shift = taken[j] * radix_binary;
+		size_t before_number[radix_index];
+		size_t sum = 0;
+		for (size_t i = 0; i != radix_index; i++)
+		{
+			before_number[i] = sum;
+			sum += element_number[taken[j]][i];
+		}
+		radix_buckets<Stats>(before_number, radix_index, n);
+		// the last pass writes to dst, and the ones before alternate
+		V* to = (passes - 1 - j) % 2 ? buffer.data() : dst.data();
+		if (j == 0)
+		{
+			for (const auto& c : src)
+				to[before_number[(unsigned_of(c) ^ flip) >> shift & (radix_index - 1)]++] = c;
+		}
+		else
+		{
+			const V* from = to == dst.data() ? buffer.data() : dst.data();
+			for (size_t i = 0; i != n; i++)
+				to[before_number[(unsigned_of(from[i]) ^ flip) >> shift & (radix_index - 1)]++] = from[i];
+		}
+		Stats::move(n);
+	}
+	if (!passes)
+	{
+		// all the elements are equal
+		std::copy(src.begin(), src.end(), dst.begin());
+		Stats::move(n);
+	}
+}
+
+/**
+ * sort threads
+ * The number of threads for the parallel sorts:
+ * threads if it is not 0, otherwise the hardware threads.
+ * return unsigned
+ */
+inline unsigned sort_threads(unsigned threads = 0)
+{
+	if (threads) return threads;
+	// hardware_concurrency reads the system files on some platforms
+	static const unsigned hardware = std::thread::hardware_concurrency();
+	return hardware ? hardware : 1;
+}
+
+/**
+ * Sort_Numa
+ * The NUMA nodes of the machine (from /sys/devices/system/node on Linux),
+ * used to run a task and first touch its memory on the same node.
+ * Without Linux or with a single node, nothing is bound.
+ */
+struct Sort_Numa
+{
+	// the CPUs of every node
+	static const std::vector<std::vector<int>>& nodes()
+	{
+		static const std::vector<std::vector<int>> cpus = read_nodes();
+		return cpus;
+	}
+
+	// bind the calling thread to the CPUs of node
+	static void bind(size_t node)
+	{
+#ifdef __linux__
+		if (nodes().size() < 2) return;
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int c : nodes()[node % nodes().size()])
+			CPU_SET(c, &set);
+		sched_setaffinity(0, sizeof(set), &set);
+#else
+		(void)node;
+#endif // __linux__
+	}
+
+	// restore the CPUs of the calling thread when leaving the scope
+	struct Restore
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		bool saved;
+		Restore() : saved(nodes().size() > 1 && sched_getaffinity(0, sizeof(set), &set) == 0) {}
+		~Restore() { if (saved) sched_setaffinity(0, sizeof(set), &set); }
+#endif // __linux__
+	};
+
+private:
+	static std::vector<std::vector<int>> read_nodes()
+	{
+		std::vector<std::vector<int>> cpus;
+#ifdef __linux__
+		for (int node = 0; ; node++)
+		{
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file) break;
+			// e.g. "0-3,8-11"
+			std::vector<int> list;
+			int first, last;
+			char c;
+			while (file >> first)
+			{
+				last = first;
+				if (file.peek() == '-') file >> c >> last;
+				for (int i = first; i <= last; i++)
+					list.push_back(i);
+				if (file.peek() == ',') file >> c;
+				else break;
+			}
+			cpus.push_back(list);
+		}
+#endif // __linux__
+		return cpus;
+	}
+};
+
+/**
+ * Sort_Pool
+ * The threads of the parallel sorts, started once and shared by all of them
+ * (Sort_Pool::shared()). Every worker has its own deque of tasks:
+ * a task submitted by a worker goes to the back of its deque and is taken
+ * from there first, others go round robin; an idle worker steals from
+ * the front of the others' deques, and sleeps when all are empty.
+ * A parallel sort inside a task only queues more tasks for the same workers,
+ * so nested parallel sorts never start more threads than the pool has.
+ * A worker that is given CPUs is bound to cpus[k % cpus.size()] (Linux).
+ * A pool is an executor as well: pool(task) runs the task on a worker.
+ * Usage: Sort_Pool::configure(7, { 1, 2, 3, 4, 5, 6, 7 }); // before the first parallel sort
+ */
+class Sort_Pool
+{
+public:
+	typedef std::function<void()> Task;
+	// anything callable with a Task, e.g. the thread pool of the program
+	typedef std::function<void(Task)> Executor;
+
+	explicit Sort_Pool(unsigned workers, std::vector<int> cpus = std::vector<int>()) : pending_(0), next_(0), stop_(false)
+	{
+		for (unsigned k = 0; k != workers; k++)
+			workers_.emplace_back(new Worker);
+		for (unsigned k = 0; k != workers; k++)
+		{
+			int cpu = cpus.empty() ? -1 : cpus[k % cpus.size()];
+			workers_[k]->thread = std::thread([this, k, cpu]() { run(k, cpu); });
+		}
+	}
+
+	Sort_Pool(const Sort_Pool&) = delete;
+	Sort_Pool& operator=(const Sort_Pool&) = delete;
+
+	~Sort_Pool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(sleep_lock_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for (auto& c : workers_)
+			c->thread.join();
+	}
+
+	unsigned workers() const { return static_cast<unsigned>(workers_.size()); }
+
+	/**
+	 * Overloaded () function to submit a task
+	 * A pool without workers runs it at once.
+	 * return void
+	 */
+	void operator()(Task task)
+	{
+		if (workers_.empty())
+		{
+			task();
+			return;
+		}
+		const size_t k = self().pool == this ? self().index : next_++ % workers_.size();
+		{
+			std::lock_guard<std::mutex> guard(workers_[k]->lock);
+			workers_[k]->tasks.push_back(std::move(task));
+		}
+		pending_++;
+		{
+			// no worker goes to sleep between the check and the wait
+			std::lock_guard<std::mutex> guard(sleep_lock_);
+		}
+		wake_.notify_one();
+	}
+
+	/**
+	 * shared
+	 * The pool of the parallel sorts, started on first use
+	 * with one worker less than sort_threads() (the calling thread sorts as well).
+	 * return Sort_Pool&
+	 */
+	static Sort_Pool& shared()
+	{
+		return *holder();
+	}
+
+	/**
+	 * configure
+	 * Replace the shared pool by one with 'workers' workers bound to cpus.
+	 * Call it before the parallel sorts, never while one runs.
+	 * return void
+	 */
+	static void configure(unsigned workers, std::vector<int> cpus = std::vector<int>())
+	{
+		holder().reset(new Sort_Pool(workers, std::move(cpus)));
+	}
+
+	/**
+	 * executor
+	 * The executor the parallel sorts submit their tasks to instead of
+	 * the shared pool, if it is set (before the parallel sorts, like configure).
+	 * return Executor&
+	 */
+	static Executor& executor()
+	{
+		static Executor e;
+		return e;
+	}
+
+private:
+	struct Worker
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+		std::thread thread;
+	};
+
+	// the pool and the index of the calling thread, if it is a worker
+	struct Self
+	{
+		Sort_Pool* pool = nullptr;
+		size_t index = 0;
+	};
+
+	static Self& self()
+	{
+		static thread_local Self s;
+		return s;
+	}
+
+	static std::unique_ptr<Sort_Pool>& holder()
+	{
+		static std::unique_ptr<Sort_Pool> pool(new Sort_Pool(sort_threads() - 1));
+		return pool;
+	}
+
+	/**
+	 * pop
+	 * Take a task from the back of the own deque, or steal one
+	 * from the front of another.
+	 * return true if there is one
+	 */
+	bool pop(size_t k, Task& task)
+	{
+		for (size_t i = 0; i != workers_.size(); i++)
+		{
+			Worker& w = *workers_[(k + i) % workers_.size()];
+			std::lock_guard<std::mutex> guard(w.lock);
+			if (w.tasks.empty()) continue;
+			if (i == 0)
+			{
+				task = std::move(w.tasks.back());
+				w.tasks.pop_back();
+			}
+			else
+			{
+				task = std::move(w.tasks.front());
+				w.tasks.pop_front();
+			}
+			pending_--;
+			return true;
+		}
+		return false;
+	}
+
+	void run(size_t k, int cpu)
+	{
+#ifdef __linux__
+		if (cpu >= 0)
+		{
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			sched_setaffinity(0, sizeof(set), &set);
+		}
+#else
+		(void)cpu;
+#endif // __linux__
+		self().pool = this;
+		self().index = k;
+		Task task;
+		while (true)
+		{
+			if (pop(k, task))
+			{
+				task();
+				task = nullptr;
+				continue;
+			}
+			std::unique_lock<std::mutex> guard(sleep_lock_);
+			wake_.wait(guard, [this]() { return stop_ || pending_ != 0; });
+			if (stop_ && pending_ == 0) return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Worker>> workers_;
+	std::atomic<size_t> pending_; // the tasks in all the deques
+	std::atomic<size_t> next_;    // the deque of the next task submitted from outside
+	std::mutex sleep_lock_;
+	std::condition_variable wake_;
+	bool stop_;
+};
+
+/**
+ * Sort_Job
+ * The progress of one parallel_for: the next task to take
+ * and the number finished, which the calling thread waits for.
+ */
+struct Sort_Job
+{
+	explicit Sort_Job(size_t count) : count(count), next(0), done(0) {}
+
+	// one more task is finished
+	void finish()
+	{
+		if (++done != count) return;
+		std::lock_guard<std::mutex> guard(lock);
+		finished.notify_all();
+	}
+
+	void wait()
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		finished.wait(guard, [this]() { return done == count; });
+	}
+
+	const size_t count;
+	std::atomic<size_t> next;
+	std::atomic<size_t> done;
+	std::mutex lock;
+	std::condition_variable finished;
+};
+
+/**
+ * parallel for
+ * Run task(0) ... task(count - 1) on at most 'threads' threads,
+ * the calling thread included. Each thread takes the next task
+ * until none is left. Every parallel sort runs its work through here.
+ * The other threads are the workers of Sort_Pool::shared()
+ * (or Sort_Pool::executor(), if set), asked to help with one task each;
+ * the calling thread takes whatever they do not, so it never waits
+ * for a task that has not started.
+ * The threads share the Sort_Deadline of the calling thread
+ * (without reporting progress).
+ * return void
+ */
+template<typename Task>
+void parallel_for(size_t count, unsigned threads, Task task)
+{
+	Sort_Deadline* deadline = Sort_Deadline::current();
+	size_t helpers = my_min(static_cast<size_t>(threads), count);
+	helpers = helpers ? helpers - 1 : 0;
+	Sort_Pool::Executor& executor = Sort_Pool::executor();
+	if (!executor) helpers = my_min(helpers, static_cast<size_t>(Sort_Pool::shared().workers()));
+	if (!helpers)
+	{
+		// the tasks stop at the deadline of the calling thread
+		Sort_Deadline::Scope scope(deadline, false);
+		for (size_t i = 0; i != count; i++)
+			task(i);
+		return;
+	}
+	// the job outlives the call if a helper starts late
+	std::shared_ptr<Sort_Job> job = std::make_shared<Sort_Job>(count);
+	Task* body = &task;
+	auto worker = [job, body, deadline]()
+	{
+		Sort_Deadline::Scope scope(deadline, false);
+		Sort_Numa::Restore restore; // a task may bind the thread to a node
+		// body is only used while a task is left, so the call has not returned
+		for (size_t i = job->next++; i < job->count; i = job->next++)
+		{
+			(*body)(i);
+			job->finish();
+		}
+	};
+	for (size_t i = 0; i != helpers; i++)
+	{
+		if (executor) executor(worker);
+		else Sort_Pool::shared()(worker);
+	}
+	worker();
+	job->wait();
+}
+
+/**
+ * merge move
+ * Merge the sorted ranges [a, a_end) and [b, b_end) into out
+ * by moving the elements; an element of a goes first when they are equal.
+ * return the end of the output
+ */
+template<typename Stats = Sort_Stats_Null, typename I, typename O>
+O merge_move(I a, I a_end, I b, I b_end, O out)
+{
+	Stats::move((a_end - a) + (b_end - b));
+	while (a != a_end && b != b_end)
+	{
+		if (Stats::less(*b, *a)) *out++ = std::move(*b++);
+		else *out++ = std::move(*a++);
+	}
+	out = std::move(a, a_end, out);
+	return std::move(b, b_end, out);
+}
+
+/**
+ * merge path
+ * Co-rank of the merge of the sorted ranges a (of size_a) and b (of size_b):
+ * the number of elements of a among the first k of the merged output,
+ * so that merging from (a + i, b + k - i) continues the same stable merge.
+ * return size_t
+ */
+template<typename Stats = Sort_Stats_Null, typename I>
+size_t merge_path(I a, size_t size_a, I b, size_t size_b, size_t k)
+{
+	size_t low = k > size_b ? k - size_b : 0, high = my_min(k, size_a);
+	while (true)
+	{
+		size_t i = low + (high - low) / 2, j = k - i;
+		if (i > 0 && j < size_b && Stats::less(b[j], a[i - 1])) high = i - 1;       // took too many of a
+		else if (j > 0 && i < size_a && !Stats::less(b[j - 1], a[i])) low = i + 1;  // took too few of a
+		else return i;
+	}
+}
+
+/**
+ * merge passes
+ * Merge the sorted runs of 'run' elements level by level between first and buffer (n elements each),
+ * starting from the runs in buffer if in_buffer. The result ends in first
+ * (merged as far as the levels went, if Stats::stop()).
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename I, typename B>
+void merge_passes(I first, B buffer, size_t n, size_t run, bool in_buffer)
+{
+	size_t levels = 0, level = 0;
+	for (size_t r = run; r < n; r *= 2)
+		levels++;
+	for (; run < n && !Stats::stop(); run *= 2)
+	{
+		for (size_t i = 0; i < n; i += 2 * run)
+		{
+			size_t mid = my_min(i + run, n), end = my_min(i + 2 * run, n);
+			if (in_buffer) merge_move<Stats>(buffer + i, buffer + mid, buffer + mid, buffer + end, first + i);
+			else merge_move<Stats>(first + i, first + mid, first + mid, first + end, buffer + i);
+		}
+		in_buffer = !in_buffer;
+		Stats::progress(++level, levels);
+	}
+	if (in_buffer)
+	{
+		std::move(buffer, buffer + n, first);
+		Stats::move(n);
+	}
+}
+
+/**
+ * merge sort (range)
+ * Sort [first, first + n) stably, with buffer (n elements) as the scratch space:
+ * insertion sort of small runs, then merge passes between the two.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null, typename B>
+void merge_sort(vec_iter<T> first, B buffer, size_t n)
+{
+	const size_t small_run = 32;
+	for (size_t i = 0; i < n; i += small_run)
+	{
+		if (i % sort_checkpoint == 0 && Stats::stop()) return;
+		insertion_sort<T, Stats>(first + i, first + my_min(i + small_run, n));
+	}
+	merge_passes<Stats>(first, buffer, n, small_run, false);
+}
+
+/**
+ * merge level
+ * Merge the neighbouring pairs of sorted runs of 'from' into 'to'.
+ * The output is cut into about 'threads' equal pieces over all the pairs,
+ * and each piece starts where merge_path puts it, so a level is shared
+ * evenly even when only one pair is left.
+ * bounds holds the first index of every run and n at the end.
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename I, typename O>
+void merge_level(I from, O to, const std::vector<size_t>& bounds, unsigned threads)
+{
+	struct Piece { size_t first, mid, end, k_beg, k_end; };
+	std::vector<Piece> pieces;
+	const size_t n = bounds.back();
+	for (size_t r = 0; r + 1 < bounds.size(); r += 2)
+	{
+		size_t first = bounds[r], mid = bounds[r + 1], end = r + 2 < bounds.size() ? bounds[r + 2] : mid;
+		size_t parts = my_max(static_cast<size_t>(1), (end - first) * threads / n);
+		for (size_t p = 0; p != parts; p++)
+			pieces.push_back(Piece{ first, mid, end, (end - first) * p / parts, (end - first) * (p + 1) / parts });
+	}
+	parallel_for(pieces.size(), threads, [&](size_t index)
+	{
+		const Piece& c = pieces[index];
+		auto a = from + c.first, b = from + c.mid;
+		size_t size_a = c.mid - c.first, size_b = c.end - c.mid;
+		size_t i_beg = merge_path<Stats>(a, size_a, b, size_b, c.k_beg);
+		size_t i_end = merge_path<Stats>(a, size_a, b, size_b, c.k_end);
+		merge_move<Stats>(a + i_beg, a + i_end, b + (c.k_beg - i_beg), b + (c.k_end - i_end), to + c.first + c.k_beg);
+	});
+}
+
+/**
+ * parallel merge sort
+ * Argument 1: the begin iterator
+ * Argument 2: the end iterator
+ * Argument 3: the number of threads (0 for the hardware threads)
+ * Each thread sorts one chunk with merge_sort, then the runs are merged
+ * pairwise, level by level, every level split over all the threads.
+ * Stable, for any type with the comparison operators; n extra elements.
+ * (Sort_Stats_Count only counts the work of the calling thread.)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void parallel_merge_sort(vec_iter<T> i, vec_iter<T> j, unsigned threads = 0)
+{
+	const size_t n = j - i;
+	if (n < 2) return;
+	std::vector<typename T::value_type> buffer(n);
+	Stats::allocate(n * sizeof(typename T::value_type));
+	// small chunks are not worth a thread
+	const size_t min_chunk = 4096;
+	threads = sort_threads(threads);
+	if (threads == 1 || n < 2 * min_chunk)
+	{
+		merge_sort<T, Stats>(i, buffer.begin(), n);
+		return;
+	}
+	const size_t chunks = my_min(static_cast<size_t>(threads), n / min_chunk);
+	std::vector<size_t> bounds;
+	for (size_t c = 0; c <= chunks; c++)
+		bounds.push_back(n * c / chunks);
+	parallel_for(chunks, threads, [&](size_t c)
+	{
+		merge_sort<T, Stats>(i + bounds[c], buffer.begin() + bounds[c], bounds[c + 1] - bounds[c]);
+	});
+	bool in_buffer = false;
+	size_t levels = 0, level = 0;
+	for (size_t r = 1; r < chunks; r *= 2)
+		levels++;
+	while (bounds.size() > 2 && !Stats::stop())
+	{
+		if (in_buffer) merge_level<Stats>(buffer.begin(), i, bounds, threads);
+		else merge_level<Stats>(i, buffer.begin(), bounds, threads);
+		in_buffer = !in_buffer;
+		// every pair of runs is one run now
+		std::vector<size_t> merged;
+		for (size_t r = 0; r < bounds.size() - 1; r += 2)
+			merged.push_back(bounds[r]);
+		merged.push_back(n);
+		bounds.swap(merged);
+		Stats::progress(++level, levels);
+	}
+	if (in_buffer)
+	{
+		parallel_for(threads, threads, [&](size_t t)
+		{
+			std::move(buffer.begin() + n * t / threads, buffer.begin() + n * (t + 1) / threads, i + n * t / threads);
+		});
+		Stats::move(n);
+	}
+}
+
+/**
+ * sort local (integer)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_local(T& vec, std::true_type)
+{
+	LSD_sort_pro_heap1<T, Stats>(vec);
+}
+
+/**
+ * sort local
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_local(T& vec, std::false_type)
+{
+	quick_sort_pro_safe<T, Stats>(vec);
+}
+
+/**
+ * sort local
+ * Sort with the best sequential engine for the element type:
+ * insertion_sort below 16 elements, LSD_sort_pro_heap1 for the radix_integral types,
+ * quick_sort_pro_safe otherwise.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_local(T& vec)
+{
+	typedef typename std::decay<typename T::value_type>::type V;
+	if (vec.size() < 2) return;
+	if (vec.size() < 16) insertion_sort<T, Stats>(vec);
+	else sort_local<T, Stats>(vec, radix_integral<V>());
+}
+
+/**
+ * insert sorted batch
+ * Argument 1: the sorted container (std::vector or std::deque)
+ * Argument 2: the new elements, in any order (a copy: std::move it if it is not needed afterwards)
+ * Sort only delta (sort_local) and merge it into sorted in place, from the back:
+ * for each element of delta, from the largest, find its place by binary search
+ * and move the larger elements of sorted up in one block.
+ * Only the elements after the smallest new one move, and there are
+ * about m log n comparisons, so the cost follows the batch, not the whole.
+ * Equal elements keep the old ones first.
+ * (Keep some capacity reserved in a vector, or the resize copies it all.)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void insert_sorted_batch(T& sorted, T delta)
+{
+	if (delta.empty()) return;
+	sort_local<T, Stats>(delta);
+	auto less = [](const typename T::value_type& a, const typename T::value_type& b) { return Stats::less(a, b); };
+	const size_t m = delta.size();
+	size_t i = sorted.size(); // sorted[0, i) are not placed yet
+	sorted.resize(i + m);
+	auto write = sorted.end();
+	for (size_t j = m; j != 0; j--)
+	{
+		auto& c = delta[j - 1];
+		// the old elements greater than c go after it
+		auto place = std::upper_bound(sorted.begin(), sorted.begin() + i, c, less);
+		write = std::move_backward(place, sorted.begin() + i, write);
+		Stats::move((sorted.begin() + i) - place);
+		i = place - sorted.begin();
+		*--write = std::move(c);
+		Stats::move();
+	}
+}
+
+/**
+ * parallel sample sort
+ * Argument 1: the begin iterator
+ * Argument 2: the end iterator
+ * Argument 3: the number of threads (0 for the hardware threads)
+ * 1. sort an oversampled sample and take the splitters of 2 buckets per thread,
+ *    laid out as a binary tree
+ * 2. classify every element by walking the tree without branches (each thread one block)
+ * 3. move the elements into the buckets, each allocated on the NUMA node that sorts it
+ * 4. sort every bucket by sort_local (radix for the radix_integral types, quick_sort_pro_safe otherwise)
+ *    and move it back to its place
+ * Not stable; n extra elements and 2 bytes per element.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void parallel_sample_sort(vec_iter<T> i, vec_iter<T> j, unsigned threads = 0)
+{
+	typedef typename T::value_type V;
+	const size_t n = j - i;
+	if (n < 2) return;
+	threads = sort_threads(threads);
+	if (threads == 1 || n < 65536)
+	{
+		std::vector<V> all(std::make_move_iterator(i), std::make_move_iterator(j));
+		sort_local<std::vector<V>, Stats>(all);
+		std::move(all.begin(), all.end(), i);
+		return;
+	}
+	TVJ_SORT_PHASE("parallel_sample_sort");
+	TVJ_SORT_STEP_FIRST("splitters");
+	Sort_Numa::Restore restore;
+	const size_t nodes = my_max(Sort_Numa::nodes().size(), static_cast<size_t>(1));
+	// the number of buckets is a power of two for the splitter tree
+	size_t levels = 1;
+	while ((static_cast<size_t>(1) << levels) < 2 * static_cast<size_t>(threads))
+		levels++;
+	const size_t buckets = static_cast<size_t>(1) << levels;
+	const size_t oversample = 32;
+	std::vector<V> sample;
+	for (size_t k = 0; k != buckets * oversample; k++)
+		sample.push_back(i[(2 * k + 1) * n / (2 * buckets * oversample)]);
+	quick_sort_pro_safe<std::vector<V>, Stats>(sample);
+	std::vector<V> tree(buckets); // tree[1] is the root, the children of k are 2k and 2k + 1
+	{
+		// fill the tree in order (left subtree, node, right subtree) with the splitters
+		size_t next = 1;
+		std::vector<size_t> stack;
+		size_t k = 1;
+		while (k < buckets || !stack.empty())
+		{
+			for (; k < buckets; k *= 2)
+				stack.push_back(k);
+			k = stack.back();
+			stack.pop_back();
+			tree[k] = sample[next++ * oversample - 1];
+			k = 2 * k + 1;
+		}
+	}
+
+	TVJ_SORT_STEP("classify");
+	const size_t blocks = threads;
+	std::vector<uint16_t> oracle(n); // the bucket of every element
+	std::vector<size_t> count(blocks * buckets, 0);
+	parallel_for(blocks, threads, [&](size_t b)
+	{
+		Sort_Numa::bind(b * nodes / blocks);
+		size_t* block_count = &count[b * buckets];
+		for (size_t k = n * b / blocks; k != n * (b + 1) / blocks; k++)
+		{
+			size_t t = 1;
+			for (size_t l = 0; l != levels; l++)
+				t = 2 * t + Stats::less(tree[t], i[k]); // no branch
+			oracle[k] = static_cast<uint16_t>(t - buckets);
+			block_count[t - buckets]++;
+		}
+	});
+
+	// nothing has moved yet
+	if (Stats::stop()) return;
+	Stats::progress(1, 3);
+
+	TVJ_SORT_STEP("scatter");
+	// offset[b * buckets + t]: where block b writes in bucket t
+	std::vector<size_t> offset(blocks * buckets), first(buckets + 1, 0);
+	for (size_t t = 0; t != buckets; t++)
+	{
+		size_t sum = 0;
+		for (size_t b = 0; b != blocks; b++)
+		{
+			offset[b * buckets + t] = sum;
+			sum += count[b * buckets + t];
+		}
+		first[t + 1] = first[t] + sum;
+	}
+	radix_buckets<Stats>(first.data(), buckets, n);
+	std::vector<std::vector<V>> bucket(buckets);
+	Stats::allocate(n * (sizeof(V) + sizeof(uint16_t)));
+	parallel_for(buckets, threads, [&](size_t t)
+	{
+		// first touch on the node that sorts the bucket
+		Sort_Numa::bind(t * nodes / buckets);
+		bucket[t].resize(first[t + 1] - first[t]);
+	});
+	parallel_for(blocks, threads, [&](size_t b)
+	{
+		Sort_Numa::bind(b * nodes / blocks);
+		size_t* block_offset = &offset[b * buckets];
+		for (size_t k = n * b / blocks; k != n * (b + 1) / blocks; k++)
+			bucket[oracle[k]][block_offset[oracle[k]]++] = std::move(i[k]);
+	});
+	Stats::move(n);
+	Stats::progress(2, 3);
+
+	TVJ_SORT_STEP("sort");
+	parallel_for(buckets, threads, [&](size_t t)
+	{
+		Sort_Numa::bind(t * nodes / buckets);
+		sort_local<std::vector<V>, Stats>(bucket[t]);
+		std::move(bucket[t].begin(), bucket[t].end(), i + first[t]);
+		std::vector<V>().swap(bucket[t]);
+	});
+	Stats::move(n);
+	Stats::progress(3, 3);
+}
+
+/**
+ * merge sort
+ * Only for containers with iterators.
+ * Stable, with n extra elements.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void merge_sort(T& vec)
+{
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [](staged_vector<T>& v) { merge_sort<staged_vector<T>, Stats>(v); });
+	else
+	{
+		std::vector<typename T::value_type> buffer(vec.size());
+		Stats::allocate(vec.size() * sizeof(typename T::value_type));
+		merge_sort<T, Stats>(vec.begin(), buffer.begin(), vec.size());
+	}
+}
+
+/**
+ * merge sort copy
+ * Sort a copy of src stably into dst (resized to the size of src), leaving src as it is.
+ * The small runs are copied from src straight to dst or the buffer, whichever makes
+ * the last merge pass end in dst, so no separate copy is made.
+ * Only for containers with iterators.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void merge_sort_copy(const T& src, std::vector<typename T::value_type>& dst)
+{
+	typedef typename T::value_type V;
+	const size_t n = src.size(), small_run = 32;
+	dst.resize(n);
+	size_t levels = 0;
+	for (size_t run = small_run; run < n; run *= 2)
+		levels++;
+	std::vector<V> buffer;
+	if (levels)
+	{
+		buffer.resize(n);
+		Stats::allocate(n * sizeof(V));
+	}
+	// an odd number of merge passes starts from the buffer
+	bool in_buffer = levels % 2 == 1;
+	auto runs = in_buffer ? buffer.begin() : dst.begin();
+	auto it = src.begin();
+	for (size_t i = 0; i < n; i += small_run)
+	{
+		size_t end = my_min(i + small_run, n);
+		for (size_t k = i; k != end; k++)
+			runs[k] = *it++;
+		insertion_sort<std::vector<V>, Stats>(runs + i, runs + end);
+	}
+	Stats::move(n);
+	merge_passes<Stats>(dst.begin(), buffer.begin(), n, small_run, in_buffer);
+}
+
+/**
+ * sort copy (integer)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_copy(const T& src, std::vector<typename T::value_type>& dst, std::true_type)
+{
+	radix_sort_copy<T, Stats>(src, dst);
+}
+
+/**
+ * sort copy (comparison)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_copy(const T& src, std::vector<typename T::value_type>& dst, std::false_type)
+{
+	merge_sort_copy<T, Stats>(src, dst);
+}
+
+/**
+ * sort copy
+ * Sort a copy of src into dst, leaving src as it is:
+ * by radix_sort_copy for the radix_integral types and merge_sort_copy for other types,
+ * which write the first pass from src and end in dst, so no copy is made beforehand.
+ * Only for containers with iterators.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_copy(const T& src, std::vector<typename T::value_type>& dst)
+{
+	typedef typename T::value_type V;
+	sort_copy<T, Stats>(src, dst, radix_integral<V>());
+}
+
+/**
+ * parallel merge sort
+ * Only for containers with iterators.
+ * Argument 2: the number of threads (0 for the hardware threads)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void parallel_merge_sort(T& vec, unsigned threads = 0)
+{
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [threads](staged_vector<T>& v) { parallel_merge_sort<staged_vector<T>, Stats>(v, threads); });
+	else parallel_merge_sort<T, Stats>(vec.begin(), vec.end(), threads);
+}
+
+/**
+ * parallel sample sort
+ * Only for containers with iterators.
+ * Argument 2: the number of threads (0 for the hardware threads)
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void parallel_sample_sort(T& vec, unsigned threads = 0)
+{
+	if (is_segmented<T>::value) staged_sort<T, Stats>(vec, [threads](staged_vector<T>& v) { parallel_sample_sort<staged_vector<T>, Stats>(v, threads); });
+	else parallel_sample_sort<T, Stats>(vec.begin(), vec.end(), threads);
+}
+
+// the number of small arrays sorted together by sort_batch
+#define sort_batch_lanes 16
+
+/**
+ * sort network pairs
+ * The comparators of Batcher's odd-even merge sort for size elements,
+ * written to first and second (unless they are null).
+ * Those reaching beyond size are dropped, as if the array were padded
+ * with the largest value, which they would never move.
+ * constexpr, so that the networks of sort_network are built by the compiler.
+ * return the number of comparators
+ */
+constexpr size_t sort_network_pairs(size_t size, size_t* first, size_t* second)
+{
+	size_t n = 1, count = 0;
+	while (n < size)
+		n *= 2;
+	for (size_t p = 1; p < n; p *= 2)
+		for (size_t k = p; k >= 1; k /= 2)
+			for (size_t j = k % p; j + k < n; j += 2 * k)
+				for (size_t i = 0; i < k && i + j + k < size; i++)
+					if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+					{
+						if (first) first[count] = i + j;
+						if (second) second[count] = i + j + k;
+						count++;
+					}
+	return count;
+}
+
+/**
+ * batch network
+ * The comparators of sort_network_pairs for size elements.
+ * return std::vector<std::pair<size_t, size_t>>
+ */
+inline std::vector<std::pair<size_t, size_t>> batch_network(size_t size)
+{
+	const size_t count = sort_network_pairs(size, nullptr, nullptr);
+	std::vector<size_t> first(count), second(count);
+	sort_network_pairs(size, first.data(), second.data());
+	std::vector<std::pair<size_t, size_t>> network(count);
+	for (size_t i = 0; i != count; i++)
+		network[i] = std::make_pair(first[i], second[i]);
+	return network;
+}
+
+// the comparators of a sorting network, built at compile time
+template<size_t Size>
+struct Sort_Network_Pairs
+{
+	size_t first[Size ? Size : 1];
+	size_t second[Size ? Size : 1];
+};
+
+/**
+ * sort network of
+ * The sorting network for N elements (sort_network_pairs), built at compile time.
+ * return Sort_Network_Pairs
+ */
+template<size_t N>
+constexpr Sort_Network_Pairs<sort_network_pairs(N, nullptr, nullptr)> sort_network_of()
+{
+	Sort_Network_Pairs<sort_network_pairs(N, nullptr, nullptr)> network{};
+	sort_network_pairs(N, network.first, network.second);
+	return network;
+}
+
+/**
+ * sort network exchange
+ * One comparator: a gets the smaller and b the larger of the two,
+ * chosen without a branch for numbers (a min and a max).
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename V>
+TVJ_CONSTEXPR20 inline void sort_network_exchange(V& a, V& b)
+{
+	if (Stats::enabled && Stats::less(b, a)) Stats::swap();
+	if (std::is_arithmetic<V>::value)
+	{
+		// compiles to a min and a max (or conditional moves)
+		const V x = a, y = b;
+		a = y < x ? y : x;
+		b = y < x ? x : y;
+	}
+	else if (b < a)
+	{
+		V temp = std::move(a);
+		a = std::move(b);
+		b = std::move(temp);
+	}
+}
+
+/**
+ * sort network apply
+ * Run the comparators K of the network for N elements on data, one after another,
+ * expanded into straight-line code.
+ * return void
+ */
+template<size_t N, typename Stats = Sort_Stats_Null, typename I, size_t... K>
+TVJ_CONSTEXPR20 void sort_network_apply(I data, std::index_sequence<K...>)
+{
+	constexpr auto network = sort_network_of<N>();
+	int order[] = { 0, (sort_network_exchange<Stats>(data[network.first[K]], data[network.second[K]]), 0)... };
+	(void)order;
+	(void)network;
+	(void)data; // no exchange for N = 0 and N = 1
+}
+
+/**
+ * sort network
+ * Sort the N elements from data (an iterator or a pointer) by the sorting network for N elements,
+ * which the compiler builds and unrolls, so a fixed-size sort has no loops and no branches.
+ * Worth it for small N (up to about 32); constexpr from C++20 on.
+ * return void
+ */
+template<size_t N, typename Stats = Sort_Stats_Null, typename I>
+TVJ_CONSTEXPR20 void sort_network(I data)
+{
+	sort_network_apply<N, Stats>(data, std::make_index_sequence<sort_network_pairs(N, nullptr, nullptr)>());
+}
+
+/**
+ * sort network (std::array)
+ * return void
+ */
+template<typename Stats = Sort_Stats_Null, typename V, size_t N>
+TVJ_CONSTEXPR20 void sort_network(std::array<V, N>& arr)
+{
+	sort_network<N, Stats>(arr.begin());
+}
+
+/**
+ * sort batch lanes
+ * Sort count (at most sort_batch_lanes) arrays of the same length,
+ * starting at data + start[w], with one sorting network:
+ * the arrays are transposed into lanes (element k of array w at lanes[k * lanes + w]),
+ * so every comparator is a min and a max over all the lanes at once,
+ * which the compiler turns into SIMD instructions. Missing lanes repeat the first array.
+ * return void
+ */
+template<typename V, typename Stats = Sort_Stats_Null, typename I>
+void sort_batch_lanes_of(I data, const size_t* start, size_t count, size_t length,
+	const std::vector<std::pair<size_t, size_t>>& network, V* lanes)
+{
+	const size_t width = sort_batch_lanes;
+	for (size_t k = 0; k != length; k++)
+		for (size_t w = 0; w != width; w++)
+			lanes[k * width + w] = data[start[w < count ? w : 0] + k];
+	for (const auto& c : network)
+	{
+		V* a = lanes + c.first * width;
+		V* b = lanes + c.second * width;
+		if (Stats::enabled)
+		{
+			for (size_t w = 0; w != count; w++)
+				if (Stats::less(b[w], a[w])) Stats::swap();
+		}
+		// min and max without a branch, through local copies
+		// so that the compiler sees that a and b do not overlap
+		V x[sort_batch_lanes], y[sort_batch_lanes];
+		for (size_t w = 0; w != width; w++)
+		{
+			x[w] = a[w];
+			y[w] = b[w];
+		}
+		for (size_t w = 0; w != width; w++)
+			a[w] = y[w] < x[w] ? y[w] : x[w];
+		for (size_t w = 0; w != width; w++)
+			b[w] = y[w] < x[w] ? x[w] : y[w];
+	}
+	for (size_t k = 0; k != length; k++)
+		for (size_t w = 0; w != count; w++)
+			data[start[w] + k] = lanes[k * width + w];
+	Stats::move(2 * length * count);
+}
+
+/**
+ * sort batch range
+ * Sort one small array alone: insertion_sort up to 16 elements,
+ * quick_sort_pro_safe above.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_batch_range(vec_iter<T> i, vec_iter<T> j)
+{
+	if (j - i < 2) return;
+	if (j - i <= 16) insertion_sort<T, Stats>(i, j);
+	else quick_sort_pro_safe<T, Stats>(i, j);
+}
+
+/**
+ * sort batch
+ * Argument 1: the flat buffer of the arrays
+ * Argument 2: the length of every array (the last one may be shorter)
+ * Argument 3: the number of threads (0 for the hardware threads)
+ * Sort every array of the buffer. Arrays of numbers up to 64 elements
+ * go sort_batch_lanes at a time through one sorting network
+ * (see sort_batch_lanes_of); others are sorted one by one.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_batch(T& flat, size_t segment, unsigned threads = 0)
+{
+	typedef typename T::value_type V;
+	if (segment < 2) return;
+	const size_t width = sort_batch_lanes;
+	const size_t segments = flat.size() / segment;
+	const size_t groups = (segments + width - 1) / width;
+	const size_t groups_per_task = 256;
+	auto data = flat.begin();
+	if (std::is_arithmetic<V>::value && segment <= 64)
+	{
+		const auto network = batch_network(segment);
+		parallel_for((groups + groups_per_task - 1) / groups_per_task, sort_threads(threads), [&](size_t task)
+		{
+			std::vector<V> lanes(segment * width);
+			size_t start[sort_batch_lanes];
+			for (size_t g = task * groups_per_task; g != my_min(groups, (task + 1) * groups_per_task); g++)
+			{
+				size_t count = my_min(width, segments - g * width);
+				for (size_t w = 0; w != count; w++)
+					start[w] = (g * width + w) * segment;
+				sort_batch_lanes_of<V, Stats>(data, start, count, segment, network, lanes.data());
+			}
+		});
+	}
+	else
+	{
+		parallel_for((groups + groups_per_task - 1) / groups_per_task, sort_threads(threads), [&](size_t task)
+		{
+			for (size_t s = task * groups_per_task * width; s != my_min(segments, (task + 1) * groups_per_task * width); s++)
+				sort_batch_range<T, Stats>(data + s * segment, data + (s + 1) * segment);
+		});
+	}
+	// the last, shorter array
+	sort_batch_range<T, Stats>(data + segments * segment, flat.end());
+}
+
+/**
+ * segmented sort range
+ * Sort one medium segment: sort_batch_range, or radix through
+ * a contiguous copy (buffer) for the radix_integral types from 1024 elements.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void segmented_sort_range(vec_iter<T> i, vec_iter<T> j, std::vector<typename T::value_type>& buffer)
+{
+	typedef typename T::value_type V;
+	if (radix_integral<V>::value && j - i >= 1024)
+	{
+		buffer.assign(std::make_move_iterator(i), std::make_move_iterator(j));
+		sort_local<std::vector<V>, Stats>(buffer);
+		std::move(buffer.begin(), buffer.end(), i);
+		Stats::move(2 * buffer.size());
+	}
+	else sort_batch_range<T, Stats>(i, j);
+}
+
+/**
+ * segmented sort
+ * Argument 1: the values of all the segments
+ * Argument 2: the offsets: segment s is [offsets[s], offsets[s + 1])
+ * Argument 3: the number of threads (0 for the hardware threads)
+ * Sort every segment, by the size of the segment:
+ * - tiny (numbers, up to 64): grouped by length, 16 at a time by the sorting networks of sort_batch
+ * - medium: one by one, by radix (the radix_integral types) or quick_sort_pro_safe
+ * - huge (more than a thread's share of all the elements): parallel_sample_sort with all the threads
+ * The tiny and medium segments are cut into tasks of about the same number
+ * of elements (not of segments), which the threads take in turn.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void segmented_sort(T& values, const std::vector<size_t>& offsets, unsigned threads = 0)
+{
+	typedef typename T::value_type V;
+	if (offsets.size() < 2) return;
+	threads = sort_threads(threads);
+	const size_t segments = offsets.size() - 1, max_network = 64;
+	const size_t width = sort_batch_lanes;
+	const size_t total = offsets.back() - offsets.front();
+	const size_t huge = threads > 1 ? my_max(total / threads, static_cast<size_t>(65536)) : static_cast<size_t>(-1);
+	const size_t task_elements = my_max(total / (8 * threads), static_cast<size_t>(4096));
+	const size_t tiny = std::is_arithmetic<V>::value ? max_network : 1;
+	auto data = values.begin();
+	auto length = [&](size_t s) { return offsets[s + 1] - offsets[s]; };
+
+	TVJ_SORT_PHASE("segmented_sort");
+	TVJ_SORT_STEP_FIRST("classify");
+	// the tiny segments ordered by length (counting sort), then the medium ones
+	std::vector<size_t> count(max_network + 2, 0), order, large;
+	for (size_t s = 0; s != segments; s++)
+	{
+		if (length(s) < 2) continue;
+		if (length(s) <= tiny) count[length(s) + 1]++;
+		else if (length(s) < huge) order.push_back(s);
+		else large.push_back(s);
+	}
+	for (size_t l = 1; l != count.size(); l++)
+		count[l] += count[l - 1];
+	const size_t tiny_segments = count.back();
+	order.insert(order.begin(), tiny_segments, 0);
+	for (size_t s = 0; s != segments; s++)
+		if (length(s) >= 2 && length(s) <= tiny) order[count[length(s)]++] = s;
+	// count[l] is now where the tiny segments longer than l begin in order
+	std::vector<std::vector<std::pair<size_t, size_t>>> network(max_network + 1);
+	for (size_t l = 2; l <= tiny; l++)
+		if (count[l] != count[l - 1]) network[l] = batch_network(l);
+
+	// cut order into tasks of about task_elements elements;
+	// a task of tiny segments ends at a multiple of the lanes within one length
+	std::vector<size_t> task_first(1, 0);
+	size_t elements = 0;
+	for (size_t k = 0; k != order.size(); k++)
+	{
+		elements += length(order[k]);
+		size_t l = length(order[k]);
+		bool lanes_full = k >= tiny_segments || (k + 1 - count[l - 1]) % width == 0 || k + 1 == count[l];
+		if (elements >= task_elements && lanes_full)
+		{
+			task_first.push_back(k + 1);
+			elements = 0;
+		}
+	}
+	if (task_first.back() != order.size()) task_first.push_back(order.size());
+
+	TVJ_SORT_STEP("tiny and medium");
+	parallel_for(task_first.size() - 1, threads, [&](size_t task)
+	{
+		std::vector<V> lanes(tiny * width), buffer;
+		size_t start[sort_batch_lanes];
+		const size_t end = task_first[task + 1];
+		for (size_t k = task_first[task]; k < end; )
+		{
+			if (k >= tiny_segments)
+			{
+				segmented_sort_range<T, Stats>(data + offsets[order[k]], data + offsets[order[k] + 1], buffer);
+				k++;
+				continue;
+			}
+			// up to width tiny segments of the same length
+			size_t l = length(order[k]);
+			size_t n = my_min(my_min(end, count[l]) - k, width);
+			for (size_t w = 0; w != n; w++)
+				start[w] = offsets[order[k + w]];
+			sort_batch_lanes_of<V, Stats>(data, start, n, l, network[l], lanes.data());
+			k += n;
+		}
+	});
+
+	TVJ_SORT_STEP("huge");
+	for (size_t s : large)
+		parallel_sample_sort<T, Stats>(data + offsets[s], data + offsets[s + 1], threads);
+}
+
+/**
+ * sort batch
+ * Argument 1: the flat buffer of the arrays
+ * Argument 2: the offsets of the arrays: array s is [offsets[s], offsets[s + 1])
+ * Argument 3: the number of threads (0 for the hardware threads)
+ * The same as segmented_sort.
+ * return void
+ */
+template<typename T, typename Stats = Sort_Stats_Null>
+void sort_batch(T& flat, const std::vector<size_t>& offsets, unsigned threads = 0)
+{
+	segmented_sort<T, Stats>(flat, offsets, threads);
+}
+
+/**
+ * Sort_Thread_Executor
+ * The default executor of sort_async and Sort_Stream:
+ * runs every task on a new detached thread.
+ * An executor is anything callable with a std::function<void()>.
+ */
+struct Sort_Thread_Executor
+{
+	void operator()(std::function<void()> task) const
+	{
+		std::thread(std::move(task)).detach();
+	}
+};
+
+/**
+ * sort async
+ * Argument 1: the container, which must live until the future is ready
+ * Argument 2: the executor that runs the sort
+ * Argument 3: the number of threads of parallel_sample_sort (0 for the hardware threads)
+ * Sort vec with parallel_sample_sort on the executor without waiting.
+ * return std::future<void> (ready when vec is sorted, or holding the exception)
+ */
+template<typename T, typename Stats = Sort_Stats_Null, typename Executor = Sort_Thread_Executor>
+std::future<void> sort_async(T& vec, Executor executor = Executor(), unsigned threads = 0)
+{
+	auto promise = std::make_shared<std::promise<void>>();
+	auto future = promise->get_future();
+	executor(std::function<void()>([&vec, promise, threads]()
+	{
+		try
+		{
+			parallel_sample_sort<T, Stats>(vec, threads);
+			promise->set_value();
+		}
+		catch (...)
+		{
+			promise->set_exception(std::current_exception());
+		}
+	}));
+	return future;
+}
+
+/**
+ * Sort_Stream
+ * Sort data that arrives in chunks: every chunk is sorted on the executor
+ * as soon as it is pushed (by sort_local: radix for the radix_integral types, quick_sort_pro_safe otherwise),
+ * while the caller keeps reading, so only the merge of the sorted chunks
+ * is left when finish is called. The merge levels are split over the
+ * threads by merge path, as in parallel_merge_sort.
+ *   Sort_Stream<int> stream;
+ *   while (read(chunk)) stream.push(std::move(chunk));
+ *   std::vector<int> sorted = stream.finish();
+ */
+template<typename V, typename Stats = Sort_Stats_Null, typename Executor = Sort_Thread_Executor>
+class Sort_Stream
+{
+public:
+	Sort_Stream(Executor executor = Executor(), unsigned threads = 0) : executor_(executor), threads_(threads) {}
+
+	Sort_Stream(const Sort_Stream&) = delete;
+	Sort_Stream& operator=(const Sort_Stream&) = delete;
+
+	~Sort_Stream()
+	{
+		// the tasks use the chunks
+		for (auto& c : sorted_)
+			if (c.valid()) c.wait();
+	}
+
+	/**
+	 * push
+	 * Take a chunk and sort it on the executor.
+	 * return void
+	 */
+	void push(std::vector<V> chunk)
+	{
+		chunks_.emplace_back(new std::vector<V>(std::move(chunk)));
+		std::vector<V>* c = chunks_.back().get();
+		auto promise = std::make_shared<std::promise<void>>();
+		sorted_.push_back(promise->get_future());
+		executor_(std::function<void()>([c, promise]()
+		{
+			try
+			{
+				sort_local<std::vector<V>, Stats>(*c);
+				promise->set_value();
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}));
+	}
+
+	/**
+	 * push
+	 * Copy [first, last) as a chunk.
+	 * return void
+	 */
+	template<typename I>
+	void push(I first, I last)
+	{
+		push(std::vector<V>(first, last));
+	}
+
+	/**
+	 * finish
+	 * Wait for the chunks and merge them. The stream is empty afterwards.
+	 * return std::vector<V> (sorted)
+	 */
+	std::vector<V> finish()
+	{
+		std::vector<size_t> bounds(1, 0);
+		for (size_t k = 0; k != chunks_.size(); k++)
+		{
+			sorted_[k].get(); // throws what the sort threw
+			bounds.push_back(bounds.back() + chunks_[k]->size());
+		}
+		const size_t n = bounds.back();
+		std::vector<V> result, buffer(n);
+		result.reserve(n);
+		for (auto& c : chunks_)
+		{
+			std::move(c->begin(), c->end(), std::back_inserter(result));
+			std::vector<V>().swap(*c);
+		}
+		chunks_.clear();
+		sorted_.clear();
+		Stats::allocate(n * sizeof(V));
+		Stats::move(n);
+		const unsigned threads = sort_threads(threads_);
+		bool in_buffer = false;
+		bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end()); // no empty chunks
+		while (bounds.size() > 2)
+		{
+			if (in_buffer) merge_level<Stats>(buffer.begin(), result.begin(), bounds, threads);
+			else merge_level<Stats>(result.begin(), buffer.begin(), bounds, threads);
+			in_buffer = !in_buffer;
+			std::vector<size_t> merged;
+			for (size_t r = 0; r < bounds.size() - 1; r += 2)
+				merged.push_back(bounds[r]);
+			merged.push_back(n);
+			bounds.swap(merged);
+		}
+		if (in_buffer) result.swap(buffer);
+		return result;
+	}
+
+	/**
+	 * finish async
+	 * finish on the executor.
+	 * return std::future<std::vector<V>>
+	 */
+	std::future<std::vector<V>> finish_async()
+	{
+		auto promise = std::make_shared<std::promise<std::vector<V>>>();
+		auto future = promise->get_future();
+		executor_(std::function<void()>([this, promise]()
+		{
+			try
+			{
+				promise->set_value(finish());
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+			}
+		}));
+		return future;
+	}
+
+private:
+	Executor executor_;
+	unsigned threads_;
+	std::vector<std::unique_ptr<std::vector<V>>> chunks_; // the chunks do not move while they are sorted
+	std::vector<std::future<void>> sorted_;                // ready when the chunk of the same index is sorted
+};
+
 #endif // !_TVJ_SORT_
 
 // ALL RIGHTS RESERVED (C) 2021 Teddy van Jerry
\ No newline at end of file
@@ -0,0 +1,471 @@
+/*
+ * File: TVJ_Sort_Dist.h
+ * --------------------
+ *
+ * @author: Teddy van Jerry
+ * @licence: The MIT Licence
+ * @compiler: At least C++/14, POSIX (Linux)
+ *
+ * @version 1.0 2026/10/19
+ * - initial version (dist_sort over Unix or TCP sockets)
+ *
+ * @note: The distributed sort of TVJ_Sort.
+ * Every process of a Sort_Dist_Group holds one shard;
+ * after dist_sort the shards are sorted and range-partitioned by rank.
+ *
+ */
+
+#pragma once
+
+#ifndef _TVJ_SORT_DIST_
+#define _TVJ_SORT_DIST_
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <type_traits>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include "TVJ_Sort.h"
+
+/**
+ * Sort_Dist_Group
+ * N processes connected to each other by stream sockets:
+ * Unix sockets between processes forked on one host (fork_local),
+ * or TCP between hosts (connect_tcp, or fork_tcp on one host).
+ */
+class Sort_Dist_Group
+{
+public:
+	Sort_Dist_Group() {}
+
+	~Sort_Dist_Group()
+	{
+		close_all();
+	}
+
+	Sort_Dist_Group(const Sort_Dist_Group&) = delete;
+	Sort_Dist_Group& operator=(const Sort_Dist_Group&) = delete;
+
+	int rank() const { return rank_; }
+
+	int size() const { return static_cast<int>(sockets_.size()); }
+
+	/**
+	 * fork local
+	 * Fork processes - 1 workers connected by Unix sockets.
+	 * return the rank of this process (0 for the calling one), or -1 on error
+	 */
+	int fork_local(int processes)
+	{
+		close_all();
+		// pair[i][j] connects rank i (side 0) and rank j (side 1), i < j
+		std::vector<std::vector<int>> pair(processes, std::vector<int>(2 * processes, -1));
+		for (int i = 0; i != processes; i++)
+		{
+			for (int j = i + 1; j != processes; j++)
+			{
+				int fd[2];
+				if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd) != 0) return -1;
+				pair[i][2 * j] = fd[0];
+				pair[i][2 * j + 1] = fd[1];
+			}
+		}
+		int rank = spawn(processes);
+		if (rank < 0) return -1;
+		sockets_.assign(processes, -1);
+		for (int i = 0; i != processes; i++)
+		{
+			for (int j = i + 1; j != processes; j++)
+			{
+				// keep the sides of this rank, close the others
+				if (i == rank) sockets_[j] = pair[i][2 * j];
+				else ::close(pair[i][2 * j]);
+				if (j == rank) sockets_[i] = pair[i][2 * j + 1];
+				else ::close(pair[i][2 * j + 1]);
+			}
+		}
+		rank_ = rank;
+		return rank;
+	}
+
+	/**
+	 * fork tcp
+	 * Fork processes - 1 workers connected by TCP on 127.0.0.1,
+	 * rank r listening on port + r.
+	 * return the rank of this process (0 for the calling one), or -1 on error
+	 */
+	int fork_tcp(int processes, int port)
+	{
+		close_all();
+		int rank = spawn(processes);
+		if (rank < 0) return -1;
+		std::vector<std::string> addresses;
+		for (int i = 0; i != processes; i++)
+			addresses.push_back("127.0.0.1:" + std::to_string(port + i));
+		return connect_tcp(rank, addresses) ? rank : -1;
+	}
+
+	/**
+	 * connect tcp
+	 * Connect this process as rank to the others, addresses[i] being
+	 * "host:port" of rank i. Rank i listens on its port, connects to
+	 * the lower ranks (retrying while they start) and accepts the higher ones.
+	 * return bool
+	 */
+	bool connect_tcp(int rank, const std::vector<std::string>& addresses)
+	{
+		close_all();
+		const int processes = static_cast<int>(addresses.size());
+		sockets_.assign(processes, -1);
+		rank_ = rank;
+		int listener = -1;
+		if (rank + 1 != processes)
+		{
+			listener = listen_on(addresses[rank]);
+			if (listener < 0) return false;
+		}
+		for (int i = 0; i != rank; i++)
+		{
+			sockets_[i] = connect_to(addresses[i]);
+			uint32_t me = static_cast<uint32_t>(rank);
+			if (sockets_[i] < 0 || !send_bytes(sockets_[i], &me, sizeof(me))) return close_listener(listener);
+		}
+		for (int i = rank + 1; i != processes; i++)
+		{
+			int fd = ::accept(listener, nullptr, nullptr);
+			uint32_t peer = 0;
+			if (fd < 0 || !recv_bytes(fd, &peer, sizeof(peer)) || peer <= static_cast<uint32_t>(rank)
+				|| peer >= static_cast<uint32_t>(processes) || sockets_[peer] >= 0)
+			{
+				if (fd >= 0) ::close(fd);
+				return close_listener(listener);
+			}
+			sockets_[peer] = fd;
+		}
+		if (listener >= 0) ::close(listener);
+		for (int fd : sockets_)
+		{
+			int one = 1;
+			if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		}
+		return true;
+	}
+
+	/**
+	 * exchange
+	 * All-to-all: send out[i] to rank i and receive in[i] from rank i.
+	 * In round r, this rank sends to rank + r while it receives
+	 * from rank - r, so every send has a receiver and nobody waits in a cycle.
+	 * return bool
+	 */
+	bool exchange(const std::vector<std::vector<char>>& out, std::vector<std::vector<char>>& in)
+	{
+		const int processes = size();
+		in.assign(processes, std::vector<char>());
+		in[rank_] = out[rank_];
+		for (int r = 1; r < processes; r++)
+		{
+			int to = (rank_ + r) % processes, from = (rank_ - r + processes) % processes;
+			bool sent = true;
+			std::thread sender([&]() { sent = send_block(sockets_[to], out[to]); });
+			bool received = recv_block(sockets_[from], in[from]);
+			sender.join();
+			if (!sent || !received) return false;
+		}
+		return true;
+	}
+
+	/**
+	 * all gather
+	 * Send mine to every rank; all[i] is what rank i sent.
+	 * return bool
+	 */
+	bool all_gather(const std::vector<char>& mine, std::vector<std::vector<char>>& all)
+	{
+		return exchange(std::vector<std::vector<char>>(size(), mine), all);
+	}
+
+	/**
+	 * wait
+	 * For rank 0: wait for the forked workers to exit.
+	 * return bool (true if they all exited with 0)
+	 */
+	bool wait()
+	{
+		bool ok = true;
+		for (pid_t child : children_)
+		{
+			int status = 0;
+			if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+		}
+		children_.clear();
+		return ok;
+	}
+
+private:
+	int rank_ = 0;
+	std::vector<int> sockets_;     // the socket to every rank (-1 for this one)
+	std::vector<pid_t> children_;  // the forked workers (only in rank 0)
+
+	// fork the workers, return the rank
+	int spawn(int processes)
+	{
+		for (int i = 1; i < processes; i++)
+		{
+			pid_t pid = fork();
+			if (pid < 0) return -1;
+			if (pid == 0)
+			{
+				children_.clear();
+				return i;
+			}
+			children_.push_back(pid);
+		}
+		return 0;
+	}
+
+	void close_all()
+	{
+		for (int fd : sockets_)
+			if (fd >= 0) ::close(fd);
+		sockets_.clear();
+	}
+
+	bool close_listener(int listener)
+	{
+		if (listener >= 0) ::close(listener);
+		return false;
+	}
+
+	// split "host:port"
+	static bool resolve(const std::string& address, addrinfo** result, bool passive)
+	{
+		auto colon = address.rfind(':');
+		if (colon == std::string::npos) return false;
+		addrinfo hints;
+		std::memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_STREAM;
+		if (passive) hints.ai_flags = AI_PASSIVE;
+		return getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(), &hints, result) == 0;
+	}
+
+	static int listen_on(const std::string& address)
+	{
+		addrinfo* info = nullptr;
+		if (!resolve(address, &info, true)) return -1;
+		int fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+		int one = 1;
+		if (fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+		if (fd >= 0 && (::bind(fd, info->ai_addr, info->ai_addrlen) != 0 || ::listen(fd, 64) != 0))
+		{
+			::close(fd);
+			fd = -1;
+		}
+		freeaddrinfo(info);
+		return fd;
+	}
+
+	static int connect_to(const std::string& address)
+	{
+		addrinfo* info = nullptr;
+		if (!resolve(address, &info, false)) return -1;
+		int fd = -1;
+		// the peer may not be listening yet: retry for about 10 seconds
+		for (int attempt = 0; attempt != 1000 && fd < 0; attempt++)
+		{
+			fd = ::socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+			if (fd >= 0 && ::connect(fd, info->ai_addr, info->ai_addrlen) != 0)
+			{
+				::close(fd);
+				fd = -1;
+				usleep(10000);
+			}
+		}
+		freeaddrinfo(info);
+		return fd;
+	}
+
+	static bool send_bytes(int fd, const void* data, size_t size)
+	{
+		const char* p = static_cast<const char*>(data);
+		while (size)
+		{
+			ssize_t sent = ::send(fd, p, size, MSG_NOSIGNAL);
+			if (sent <= 0) return false;
+			p += sent;
+			size -= sent;
+		}
+		return true;
+	}
+
+	static bool recv_bytes(int fd, void* data, size_t size)
+	{
+		char* p = static_cast<char*>(data);
+		while (size)
+		{
+			ssize_t received = ::recv(fd, p, size, 0);
+			if (received <= 0) return false;
+			p += received;
+			size -= received;
+		}
+		return true;
+	}
+
+	// a block is its size (8 bytes) and its bytes
+	static bool send_block(int fd, const std::vector<char>& block)
+	{
+		uint64_t size = block.size();
+		return send_bytes(fd, &size, sizeof(size)) && send_bytes(fd, block.data(), block.size());
+	}
+
+	static bool recv_block(int fd, std::vector<char>& block)
+	{
+		uint64_t size = 0;
+		if (!recv_bytes(fd, &size, sizeof(size))) return false;
+		block.resize(size);
+		return recv_bytes(fd, block.data(), size);
+	}
+};
+
+/**
+ * dist bytes
+ * The bytes of count elements from first.
+ * return std::vector<char>
+ */
+template<typename V>
+std::vector<char> dist_bytes(const V* first, size_t count)
+{
+	static_assert(std::is_trivially_copyable<V>::value, "the elements are sent as bytes");
+	const char* p = reinterpret_cast<const char*>(first);
+	return std::vector<char>(p, p + count * sizeof(V));
+}
+
+/**
+ * dist elements
+ * Append the elements in bytes to vec.
+ * return void
+ */
+template<typename V>
+void dist_elements(const std::vector<char>& bytes, std::vector<V>& vec)
+{
+	size_t old_size = vec.size();
+	vec.resize(old_size + bytes.size() / sizeof(V));
+	if (!bytes.empty()) std::memcpy(&vec[old_size], bytes.data(), bytes.size());
+}
+
+/**
+ * dist sort
+ * Sort the shards of all the ranks of group together:
+ * 1. sort the shard locally (parallel_sample_sort)
+ * 2. gather regular samples from every rank and take the same splitters on all of them
+ * 3. send the part of the shard between splitter r - 1 and splitter r to rank r (all-to-all)
+ * 4. sort what was received
+ * Afterwards every element of rank r is not greater than any element of rank r + 1.
+ * The elements have to be trivially copyable. Every rank has to call it.
+ * return bool (false if a connection failed)
+ */
+template<typename V, typename Stats = Sort_Stats_Null>
+bool dist_sort(Sort_Dist_Group& group, std::vector<V>& shard)
+{
+	const int processes = group.size();
+	if (processes < 2)
+	{
+		parallel_sample_sort<std::vector<V>, Stats>(shard);
+		return true;
+	}
+	TVJ_SORT_PHASE("dist_sort");
+	TVJ_SORT_STEP_FIRST("local sort");
+	parallel_sample_sort<std::vector<V>, Stats>(shard);
+
+	TVJ_SORT_STEP("splitters");
+	const size_t oversample = 64;
+	std::vector<V> sample;
+	const size_t samples = my_min(shard.size(), oversample * processes);
+	for (size_t k = 0; k != samples; k++)
+		sample.push_back(shard[(2 * k + 1) * shard.size() / (2 * samples)]);
+	std::vector<std::vector<char>> gathered;
+	if (!group.all_gather(dist_bytes(sample.data(), sample.size()), gathered)) return false;
+	sample.clear();
+	for (const auto& c : gathered)
+		dist_elements(c, sample);
+	// every rank sorts the same sample, so they agree on the splitters
+	quick_sort_pro_safe<std::vector<V>, Stats>(sample);
+
+	TVJ_SORT_STEP("exchange");
+	std::vector<std::vector<char>> out(processes), in;
+	size_t begin = 0;
+	for (int r = 0; r != processes; r++)
+	{
+		size_t end = shard.size();
+		if (r + 1 != processes && !sample.empty())
+		{
+			const V& splitter = sample[(r + 1) * sample.size() / processes];
+			// the elements equal to the splitter go to rank r
+			end = std::upper_bound(shard.begin() + begin, shard.end(), splitter,
+				[](const V& a, const V& b) { return Stats::less(a, b); }) - shard.begin();
+		}
+		out[r] = dist_bytes(shard.data() + begin, end - begin);
+		begin = end;
+	}
+	std::vector<V>().swap(shard);
+	if (!group.exchange(out, in)) return false;
+	out.clear();
+
+	TVJ_SORT_STEP("final sort");
+	for (auto& c : in)
+	{
+		dist_elements(c, shard);
+		std::vector<char>().swap(c);
+	}
+	Stats::move(shard.size());
+	// the parts received are sorted runs, which the local sort handles well
+	parallel_sample_sort<std::vector<V>, Stats>(shard);
+	return true;
+}
+
+/**
+ * dist is sorted
+ * Check that every shard is sorted and that the shards are in the order of the ranks.
+ * Every rank has to call it, and gets the same answer.
+ * return bool
+ */
+template<typename V>
+bool dist_is_sorted(Sort_Dist_Group& group, const std::vector<V>& shard)
+{
+	// this rank: sorted, size, first, last
+	struct Summary { uint64_t sorted, size; V first, last; };
+	Summary mine{ std::is_sorted(shard.begin(), shard.end()), shard.size(), V(), V() };
+	if (!shard.empty())
+	{
+		mine.first = shard.front();
+		mine.last = shard.back();
+	}
+	std::vector<std::vector<char>> all;
+	if (!group.all_gather(dist_bytes(&mine, 1), all)) return false;
+	bool any = false;
+	V last = V();
+	for (const auto& c : all)
+	{
+		Summary s;
+		std::memcpy(&s, c.data(), sizeof(s));
+		if (!s.sorted) return false;
+		if (!s.size) continue;
+		if (any && s.first < last) return false;
+		last = s.last;
+		any = true;
+	}
+	return true;
+}
+
+#endif // !_TVJ_SORT_DIST_
+
+// ALL RIGHTS RESERVED (C) 2021 Teddy van Jerry
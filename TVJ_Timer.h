@@ -6,9 +6,19 @@
  * @licence: The MIT Licence
  * @compiler: At least C++/11
  *
+ * @version 2.1 2026/10/19
+ * - add TVJ_Perf_Counter (hardware counters of Linux perf_event)
+ *
+ * @version 2.0 2026/10/19
+ * - use the monotonic steady_clock (or rdtsc with TVJ_TIMER_USE_RDTSC)
+ * - nanosecond resolution and the unit 'n'
+ * - bug fix (the unit of hour overflowed)
+ * - add lap and split
+ * - add TVJ_Scoped_Timer and the phase tree (TVJ_Phases)
+ *
  * @version 1.1 2021/03/09
  * - bug fix
- * 
+ *
  * @version 1.0 2021/03/01
  * - initial version
  *
@@ -20,8 +30,109 @@
 #include <ctime>
 #include <string>
 #include <iomanip>
+#include <vector>
+#include <memory>
+#include <cstring>
+#if defined (TVJ_TIMER_USE_RDTSC) && (defined (__x86_64__) || defined (__i386__))
+#include <x86intrin.h>
+#define _TVJ_TIMER_RDTSC_
+#elif defined (TVJ_TIMER_USE_RDTSC) && (defined (_M_X64) || defined (_M_IX86))
+#include <intrin.h>
+#define _TVJ_TIMER_RDTSC_
+#endif // only for x86
+#if defined (__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // only for Linux
 using namespace std::chrono;
 
+/**
+ * TVJ_Clock
+ * The monotonic clock of TVJ_Timer, in nanoseconds.
+ * It reads steady_clock, or the time stamp counter
+ * if TVJ_TIMER_USE_RDTSC is defined on x86.
+ */
+struct TVJ_Clock
+{
+	/**
+	 * now is used to return the current time in nanoseconds.
+	 * return long long
+	 */
+	static inline long long now()
+	{
+#ifdef _TVJ_TIMER_RDTSC_
+		const auto& c = calibration();
+		return c.ns_beg + static_cast<long long>((__rdtsc() - c.tick_beg) * c.ns_per_tick);
+#else
+		return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	/**
+	 * unitNanoseconds is used to return the nanoseconds of one time unit.
+	 * return long long
+	 */
+	static long long unitNanoseconds(char time_unit)
+	{
+		switch (time_unit)
+		{
+		case 'n': return 1LL;             // nanosecond
+		case 'u': return 1000LL;          // microsecond
+		case 'm': return 1000000LL;       // millisecond
+		case 's': return 1000000000LL;    // second
+		case 'M': return 60000000000LL;   // minute
+		case 'h': return 3600000000000LL; // hour
+		default:  return 1000000LL;       // millisecond
+		}
+	}
+
+	/**
+	 * unitName is used to return the name of a time unit.
+	 * return const char*
+	 */
+	static const char* unitName(char time_unit)
+	{
+		switch (time_unit)
+		{
+		case 'n': return "ns"; // nanosecond
+		case 'u': return "us"; // microsecond
+		case 'm': return "ms"; // millisecond
+		case 's': return "s";  // second
+		case 'M': return "m";  // minute
+		case 'h': return "h";  // hour
+		default:  return "";
+		}
+	}
+
+#ifdef _TVJ_TIMER_RDTSC_
+private:
+	struct Calibration
+	{
+		unsigned long long tick_beg;
+		long long ns_beg;
+		double ns_per_tick;
+	};
+
+	// measure the tick rate against steady_clock once (about 10 ms)
+	static const Calibration& calibration()
+	{
+		static const Calibration c = []()
+		{
+			auto steady_ns = []() { return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count(); };
+			long long ns_beg = steady_ns();
+			unsigned long long tick_beg = __rdtsc();
+			long long ns_end = ns_beg;
+			while (ns_end - ns_beg < 10000000) ns_end = steady_ns();
+			unsigned long long tick_end = __rdtsc();
+			return Calibration{ tick_beg, ns_beg, static_cast<double>(ns_end - ns_beg) / (tick_end - tick_beg) };
+		}();
+		return c;
+	}
+#endif
+};
+
 class TVJ_Timer
 {
 	// friendship declaration
@@ -33,14 +144,17 @@ public:
 	 * Argument 1: time unit of TVJ_Timer (default as millisecond)
 	 * Argument 2: output with unit or not
 	 */
-	TVJ_Timer(std::string time_unit = "m", bool output_with_unit = false) : time_beg(system_clock::now())
+	TVJ_Timer(std::string time_unit = "m", bool output_with_unit = false) : time_beg(TVJ_Clock::now())
 	{
+		time_lap = time_beg;
 		setUnit(time_unit, output_with_unit);
 	}
 
 	/**
 	 * setUnit is used to set the time unit of TVJ_Timer
 	 * and set whether there is unit in the output.
+	 * The unit can be 'n', 'u', 'm', 's', 'M' or 'h',
+	 * followed by ".x" to output x significant digits.
 	 * return void
 	 */
 	void setUnit(std::string time_unit, bool output_with_unit = false)
@@ -60,51 +174,103 @@ public:
 
 	/**
 	 * restart is used to restart the timer.
+	 * Laps and splits are cleared.
 	 * return void
 	 */
 	void restart()
 	{
-		time_beg = system_clock::now();
+		laps_.clear();
+		splits_.clear();
+		time_beg = time_lap = TVJ_Clock::now();
+	}
+
+	/**
+	 * durationNanoseconds is used to return the time duration in nanoseconds.
+	 * return long long
+	 */
+	long long durationNanoseconds() const
+	{
+		return TVJ_Clock::now() - time_beg;
 	}
 
 	/**
 	 * durationTime is used to return the 'long long' version of time duration.
 	 * return long long
 	 */
-	auto durationTime() const
+	long long durationTime() const
 	{
-		int x = 1000;
-		time_t t = duration_cast<microseconds>(system_clock::now() - time_beg).count();
-		switch (t_unit)
-		{
-		case 'u': x = 1;     break; // microsecond
-		case 'm': x = 1000;  break; // millisecond
-		case 's': x = 1E6;   break; // second
-		case 'M': x = 6E7;   break; // minute
-		case 'h': x = 3.6E9; break; // hour
-		default:            break;
-		}
-		return t / x;
+		return durationNanoseconds() / TVJ_Clock::unitNanoseconds(t_unit);
 	}
 
 	/**
 	 * durationTimeDouble is used to return the 'double' version of time duration.
 	 * return double
 	 */
-	auto durationTimeDouble() const
+	double durationTimeDouble() const
+	{
+		return static_cast<double>(durationNanoseconds()) / TVJ_Clock::unitNanoseconds(t_unit);
+	}
+
+	/**
+	 * lap is used to record the time since the last lap (or the start).
+	 * return long long (nanoseconds)
+	 */
+	long long lap()
+	{
+		long long now = TVJ_Clock::now();
+		laps_.push_back(now - time_lap);
+		time_lap = now;
+		return laps_.back();
+	}
+
+	/**
+	 * split is used to record the time since the start,
+	 * without stopping the timer.
+	 * return long long (nanoseconds)
+	 */
+	long long split()
+	{
+		splits_.push_back(durationNanoseconds());
+		return splits_.back();
+	}
+
+	/**
+	 * laps is used to return the recorded laps in nanoseconds.
+	 * return const vector<long long>&
+	 */
+	const std::vector<long long>& laps() const
 	{
-		double x = 1000;
-		time_t t = duration_cast<microseconds>(system_clock::now() - time_beg).count();
-		switch (t_unit)
+		return laps_;
+	}
+
+	/**
+	 * splits is used to return the recorded splits in nanoseconds.
+	 * return const vector<long long>&
+	 */
+	const std::vector<long long>& splits() const
+	{
+		return splits_;
+	}
+
+	/**
+	 * printDuration is used to print a duration (in nanoseconds)
+	 * in the unit and the precision of this timer.
+	 * return void
+	 */
+	void printDuration(std::ostream& out, long long duration_ns) const
+	{
+		if (precision) // double
+		{
+			out << std::setprecision(precision) << static_cast<double>(duration_ns) / TVJ_Clock::unitNanoseconds(t_unit);
+		}
+		else // long long
 		{
-		case 'u': x = 1;     break; // microsecond
-		case 'm': x = 1000;  break; // millisecond
-		case 's': x = 1E6;   break; // second
-		case 'M': x = 6E7;   break; // minute
-		case 'h': x = 3.6E9; break; // hour
-		default:            break;
+			out << duration_ns / TVJ_Clock::unitNanoseconds(t_unit);
+		}
+		if (o_with_unit)
+		{
+			out << TVJ_Clock::unitName(t_unit);
 		}
-		return t / x;
 	}
 
 protected:
@@ -125,32 +291,420 @@ protected:
 	}
 
 private:
-	system_clock::time_point time_beg; // the starting time
-	char t_unit = 'm';                 // the time unit (default as millisecond)
-	int precision = 0;                 // the precision of output if it is double
-	bool o_with_unit = false;          // whether output with the unit
+	long long time_beg;               // the starting time (nanoseconds)
+	long long time_lap;               // the time of the last lap (nanoseconds)
+	std::vector<long long> laps_;     // the recorded laps
+	std::vector<long long> splits_;   // the recorded splits
+	char t_unit = 'm';                // the time unit (default as millisecond)
+	int precision = 0;                // the precision of output if it is double
+	bool o_with_unit = false;         // whether output with the unit
 };
 
 /**
  * Overloaded << function to output the time
  * return ostream&
  */
-std::ostream& operator<<(std::ostream& out, const TVJ_Timer& timer)
+inline std::ostream& operator<<(std::ostream& out, const TVJ_Timer& timer)
+{
+	timer.printDuration(out, timer.durationNanoseconds());
+	return out;
+}
+
+/**
+ * TVJ_Scoped_Timer
+ * Measure the lifetime of a scope (RAII).
+ * The duration is added to a counter in nanoseconds,
+ * or printed with a label when the scope ends.
+ */
+class TVJ_Scoped_Timer
+{
+public:
+	/**
+	 * Constructor that adds the duration to total_ns.
+	 */
+	explicit TVJ_Scoped_Timer(long long& total_ns) : total(&total_ns), out(nullptr), time_beg(TVJ_Clock::now()) { }
+
+	/**
+	 * Constructor that prints "label: duration" to out.
+	 * Argument 1: the label
+	 * Argument 2: the time unit (default as millisecond)
+	 * Argument 3: the output stream (default as cerr)
+	 */
+	TVJ_Scoped_Timer(std::string label, char time_unit = 'm', std::ostream& o = std::cerr)
+		: total(nullptr), out(&o), name(label), t_unit(time_unit), time_beg(TVJ_Clock::now()) { }
+
+	~TVJ_Scoped_Timer()
+	{
+		long long elapsed = TVJ_Clock::now() - time_beg;
+		if (total) *total += elapsed;
+		if (out) *out << name << ": " << static_cast<double>(elapsed) / TVJ_Clock::unitNanoseconds(t_unit) << std::endl;
+	}
+
+	TVJ_Scoped_Timer(const TVJ_Scoped_Timer&) = delete;
+	TVJ_Scoped_Timer& operator=(const TVJ_Scoped_Timer&) = delete;
+
+private:
+	long long* total;       // the counter to add to
+	std::ostream* out;      // the stream to print to
+	std::string name;       // the label to print
+	char t_unit = 'm';      // the time unit of the printing
+	long long time_beg;     // the starting time (nanoseconds)
+};
+
+/**
+ * TVJ_Phase_Node
+ * A named phase in the phase tree.
+ */
+struct TVJ_Phase_Node
+{
+	const char* name = "";
+	long long total_ns = 0;  // the accumulated time
+	long long count = 0;     // the times of entering
+	TVJ_Phase_Node* parent = nullptr;
+	std::vector<std::unique_ptr<TVJ_Phase_Node>> children;
+};
+
+/**
+ * TVJ_Phases
+ * Named phase accumulators of the current thread.
+ * Phases entered while another phase is open become its children,
+ * so the report is a tree (e.g. pass -> scatter).
+ * Names are expected to be string literals.
+ */
+class TVJ_Phases
 {
-	timer.print(out);
-	if (timer.o_with_unit)
+public:
+	/**
+	 * root is used to return the root of the tree of this thread.
+	 * return TVJ_Phase_Node&
+	 */
+	static TVJ_Phase_Node& root()
+	{
+		static thread_local TVJ_Phase_Node root_node;
+		return root_node;
+	}
+
+	/**
+	 * enter is used to enter the child phase name of the current phase.
+	 * return TVJ_Phase_Node* (the phase entered)
+	 */
+	static TVJ_Phase_Node* enter(const char* name)
 	{
-		std::string unit;
-		switch (timer.t_unit)
+		TVJ_Phase_Node*& cur = current();
+		for (const auto& c : cur->children)
 		{
-		case 'u': unit = "us"; break; // microsecond
-		case 'm': unit = "ms"; break; // millisecond
-		case 's': unit = "s";  break; // second
-		case 'M': unit = "m";  break; // minute
-		case 'h': unit = "h";  break; // hour
-		default:            break;
+			// the same literal is usually the same pointer
+			if (c->name == name || std::strcmp(c->name, name) == 0)
+			{
+				cur = c.get();
+				return cur;
+			}
 		}
-		out << unit;
+		cur->children.emplace_back(new TVJ_Phase_Node);
+		TVJ_Phase_Node* node = cur->children.back().get();
+		node->name = name;
+		node->parent = cur;
+		cur = node;
+		return node;
+	}
+
+	/**
+	 * leave is used to leave the phase node after elapsed nanoseconds.
+	 * return void
+	 */
+	static void leave(TVJ_Phase_Node* node, long long elapsed)
+	{
+		node->total_ns += elapsed;
+		node->count++;
+		current() = node->parent;
+	}
+
+	/**
+	 * reset is used to clear the tree of this thread.
+	 * return void
+	 */
+	static void reset()
+	{
+		root().children.clear();
+		current() = &root();
+	}
+
+	/**
+	 * report is used to print the tree of this thread,
+	 * with the time in time_unit and the share of the parent phase.
+	 * return void
+	 */
+	static void report(std::ostream& out = std::cout, char time_unit = 'm')
+	{
+		out << std::left << std::setw(36) << "phase" << std::right << std::setw(14) << "total"
+			<< std::setw(10) << "calls" << std::setw(9) << "share" << std::endl;
+		for (const auto& c : root().children)
+			reportNode(out, *c, 0, time_unit);
+	}
+
+private:
+	static TVJ_Phase_Node*& current()
+	{
+		static thread_local TVJ_Phase_Node* cur = &root();
+		return cur;
+	}
+
+	static void reportNode(std::ostream& out, const TVJ_Phase_Node& node, int depth, char time_unit)
+	{
+		long long parent_ns = node.parent && node.parent->parent ? node.parent->total_ns : node.total_ns;
+		out << std::left << std::setw(36) << (std::string(2 * depth, ' ') + node.name) << std::right
+			<< std::fixed << std::setprecision(3)
+			<< std::setw(14) << static_cast<double>(node.total_ns) / TVJ_Clock::unitNanoseconds(time_unit)
+			<< std::setw(10) << node.count
+			<< std::setw(8) << std::setprecision(1) << (parent_ns ? 100.0 * node.total_ns / parent_ns : 100.0) << '%'
+			<< std::defaultfloat << std::endl;
+		for (const auto& c : node.children)
+			reportNode(out, *c, depth + 1, time_unit);
+	}
+};
+
+/**
+ * TVJ_Phase_Scope
+ * Accumulate the lifetime of a scope into the phase name (RAII).
+ */
+class TVJ_Phase_Scope
+{
+public:
+	explicit TVJ_Phase_Scope(const char* name) : node(TVJ_Phases::enter(name)), time_beg(TVJ_Clock::now()) { }
+	~TVJ_Phase_Scope()
+	{
+		TVJ_Phases::leave(node, TVJ_Clock::now() - time_beg);
+	}
+
+	/**
+	 * next is used to leave this phase and enter its sibling name,
+	 * so that consecutive steps need no extra scopes.
+	 * return void
+	 */
+	void next(const char* name)
+	{
+		long long now = TVJ_Clock::now();
+		TVJ_Phases::leave(node, now - time_beg);
+		node = TVJ_Phases::enter(name);
+		time_beg = now;
+	}
+
+	TVJ_Phase_Scope(const TVJ_Phase_Scope&) = delete;
+	TVJ_Phase_Scope& operator=(const TVJ_Phase_Scope&) = delete;
+
+private:
+	TVJ_Phase_Node* node; // the phase entered
+	long long time_beg;   // the starting time (nanoseconds)
+};
+
+/**
+ * TVJ_Perf_Counter
+ * A timer that also reads the hardware counters of Linux perf_event
+ * (cycles, instructions, LLC misses, dTLB misses and branch misses)
+ * of the calling thread in user space.
+ * A counter that the kernel (or the hardware) refuses is unavailable,
+ * and every counter is unavailable on other systems.
+ * Usage:
+ *     TVJ_Perf_Counter perf("m.4", true);
+ *     perf.start(); LSD_sort_pro_heap1(vec); perf.stop();
+ *     std::cout << perf << std::endl; // 12.34ms, cycles: ..., IPC: ...
+ */
+class TVJ_Perf_Counter
+{
+	// friendship declaration
+	friend std::ostream& operator<<(std::ostream& out, const TVJ_Perf_Counter& perf);
+
+public:
+	enum Event { cycles, instructions, llc_misses, dtlb_misses, branch_misses, event_count };
+
+	/**
+	 * Constructor that opens the counters.
+	 * The arguments are the same as TVJ_Timer.
+	 */
+	TVJ_Perf_Counter(std::string time_unit = "m", bool output_with_unit = false) : timer(time_unit, output_with_unit)
+	{
+		for (int i = 0; i != event_count; i++)
+		{
+			fd[i] = open(static_cast<Event>(i));
+			values[i] = -1;
+		}
+	}
+
+	~TVJ_Perf_Counter()
+	{
+#if defined (__linux__)
+		for (int i = 0; i != event_count; i++)
+			if (fd[i] != -1) close(fd[i]);
+#endif
+	}
+
+	TVJ_Perf_Counter(const TVJ_Perf_Counter&) = delete;
+	TVJ_Perf_Counter& operator=(const TVJ_Perf_Counter&) = delete;
+
+	/**
+	 * available is used to check whether the counter e is open.
+	 * return bool
+	 */
+	bool available(Event e) const
+	{
+		return fd[e] != -1;
+	}
+
+	/**
+	 * available is used to check whether any counter is open.
+	 * return bool
+	 */
+	bool available() const
+	{
+		for (int i = 0; i != event_count; i++)
+			if (fd[i] != -1) return true;
+		return false;
+	}
+
+	/**
+	 * start is used to reset the counters and start counting and timing.
+	 * return void
+	 */
+	void start()
+	{
+#if defined (__linux__)
+		for (int i = 0; i != event_count; i++)
+		{
+			if (fd[i] == -1) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+#endif
+		timer.restart();
+		duration_ns = 0;
+	}
+
+	/**
+	 * stop is used to stop counting and timing and read the counters.
+	 * return void
+	 */
+	void stop()
+	{
+		duration_ns = timer.durationNanoseconds();
+#if defined (__linux__)
+		for (int i = 0; i != event_count; i++)
+		{
+			values[i] = -1;
+			if (fd[i] == -1) continue;
+			ioctl(fd[i], PERF_EVENT_IOC_DISABLE, 0);
+			// value, time enabled, time running
+			unsigned long long data[3]{ 0 };
+			if (read(fd[i], data, sizeof data) != static_cast<ssize_t>(sizeof data)) continue;
+			// scale up if the kernel had to multiplex the counters
+			if (data[2] && data[2] < data[1])
+				values[i] = static_cast<long long>(static_cast<double>(data[0]) * data[1] / data[2]);
+			else if (data[2])
+				values[i] = static_cast<long long>(data[0]);
+		}
+#endif
+	}
+
+	/**
+	 * value is used to return the reading of e in the last start-stop,
+	 * or -1 if it is unavailable.
+	 * return long long
+	 */
+	long long value(Event e) const
+	{
+		return values[e];
+	}
+
+	/**
+	 * durationNanoseconds is used to return the duration of the last start-stop.
+	 * return long long
+	 */
+	long long durationNanoseconds() const
+	{
+		return duration_ns;
+	}
+
+	/**
+	 * name is used to return the name of e.
+	 * return const char*
+	 */
+	static const char* name(Event e)
+	{
+		static const char* names[event_count] = { "cycles", "instructions", "LLC misses", "dTLB misses", "branch misses" };
+		return names[e];
+	}
+
+private:
+	// open the counter of e for this thread (disabled), return -1 on failure
+	static int open(Event e)
+	{
+#if defined (__linux__)
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof attr);
+		attr.size = sizeof attr;
+		attr.disabled = 1;
+		attr.exclude_kernel = 1; // allowed with perf_event_paranoid up to 2
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		switch (e)
+		{
+		case cycles:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_CPU_CYCLES;
+			break;
+		case instructions:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+			break;
+		case llc_misses:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		case dtlb_misses:
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			break;
+		case branch_misses:
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+			break;
+		default:
+			return -1;
+		}
+		long fd_ = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+		return fd_ < 0 ? -1 : static_cast<int>(fd_);
+#else
+		(void)e;
+		return -1;
+#endif
+	}
+
+	TVJ_Timer timer;              // the timer of the region
+	long long duration_ns = 0;    // the duration of the last start-stop
+	int fd[event_count];          // the file descriptors of the counters
+	long long values[event_count];// the readings of the last start-stop
+};
+
+/**
+ * Overloaded << function to output the duration and the counters
+ * return ostream&
+ */
+inline std::ostream& operator<<(std::ostream& out, const TVJ_Perf_Counter& perf)
+{
+	// the precision of the caller's stream is restored at the end
+	const std::streamsize precision = out.precision();
+	perf.timer.printDuration(out, perf.duration_ns);
+	for (int i = 0; i != TVJ_Perf_Counter::event_count; i++)
+	{
+		auto e = static_cast<TVJ_Perf_Counter::Event>(i);
+		out << ", " << TVJ_Perf_Counter::name(e) << ": ";
+		if (perf.value(e) < 0) out << "n/a";
+		else out << perf.value(e);
+	}
+	if (perf.value(TVJ_Perf_Counter::cycles) > 0 && perf.value(TVJ_Perf_Counter::instructions) >= 0)
+	{
+		out << ", IPC: " << std::setprecision(3)
+			<< static_cast<double>(perf.value(TVJ_Perf_Counter::instructions)) / perf.value(TVJ_Perf_Counter::cycles);
 	}
+	out.precision(precision);
 	return out;
-}
\ No newline at end of file
+}